@@ -0,0 +1,188 @@
+#define RBS_GEN_NO_MAIN
+#include "gen.cpp"
+#include <filesystem>
+#ifdef _WIN32
+#define chdir _chdir
+#endif
+
+struct BenchResult {
+    string name;
+    vector<double> micros;
+    double percentile(double p) const {
+        if (micros.empty()) return 0.0;
+        size_t rank = static_cast<size_t>(ceil(p / 100.0 * micros.size()));
+        return micros[min(micros.size(), max(rank, size_t(1))) - 1];
+    }
+    double mean() const {
+        double total = 0.0;
+        for (double value : micros) total += value;
+        return micros.empty() ? 0.0 : total / micros.size();
+    }
+};
+
+class BenchSuite {
+private:
+    vector<BenchResult> results;
+    streambuf* consoleBuffer;
+    ostringstream discarded;
+public:
+    BenchSuite() : consoleBuffer(cout.rdbuf()) { cout.rdbuf(discarded.rdbuf()); }
+    ~BenchSuite() { cout.rdbuf(consoleBuffer); }
+    template <typename Body>
+    void measure(const string& name, size_t iterations, Body&& body) {
+        BenchResult result{name, {}};
+        result.micros.reserve(iterations);
+        for (size_t i = 0; i < iterations; i++) {
+            auto start = chrono::steady_clock::now();
+            body(i);
+            result.micros.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+            discarded.str("");
+        }
+        sort(result.micros.begin(), result.micros.end());
+        results.push_back(move(result));
+    }
+    void report(const string& dataset, size_t nodes, size_t edges, size_t drivers, size_t rides) {
+        ostream out(consoleBuffer);
+        out << fixed << setprecision(3);
+        out << "{\n  \"dataset\": \"" << dataset << "\",\n  \"nodes\": " << nodes << ",\n  \"edges\": " << edges
+            << ",\n  \"drivers\": " << drivers << ",\n  \"rides\": " << rides << ",\n  \"benchmarks\": [\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchResult& r = results[i];
+            out << "    {\"name\": \"" << r.name << "\", \"iterations\": " << r.micros.size()
+                << ", \"unit\": \"us\", \"mean\": " << r.mean() << ", \"p50\": " << r.percentile(50)
+                << ", \"p90\": " << r.percentile(90) << ", \"p99\": " << r.percentile(99)
+                << ", \"max\": " << (r.micros.empty() ? 0.0 : r.micros.back()) << "}"
+                << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+    }
+};
+
+// Synthetic cities come from the gen.cpp generator, scaled so history and fleet grow with the map.
+string writeSyntheticCity(size_t nodes, uint32_t seed) {
+    SyntheticOptions options;
+    options.outDir = "bench_synthetic_" + to_string(nodes);
+    options.locations = max(size_t(2), nodes);
+    options.drivers = max(size_t(3), nodes / 10);
+    options.users = max(size_t(100), nodes / 5);
+    options.rides = nodes * 10;
+    options.bookings = 0;
+    options.seed = seed;
+    return writeSyntheticData(options, cerr) ? options.outDir : "";
+}
+
+int main(int argc, char* argv[]) {
+    string dataDir = ".";
+    size_t queries = 2000, loads = 20, synthetic = 0;
+    uint32_t seed = 42;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string flag = argv[i];
+        if (flag == "--data") dataDir = argv[i + 1];
+        else if (flag == "--synthetic") synthetic = stoul(argv[i + 1]);
+        else if (flag == "--queries") queries = stoul(argv[i + 1]);
+        else if (flag == "--loads") loads = stoul(argv[i + 1]);
+        else if (flag == "--seed") seed = static_cast<uint32_t>(stoul(argv[i + 1]));
+        else { cerr << "Unknown option " << flag << "\n"; return 1; }
+    }
+    if (synthetic > 0 && chdir(dataDir.c_str()) == 0) dataDir = writeSyntheticCity(synthetic, seed);
+    if (dataDir.empty()) return 1;
+    if (chdir(dataDir.c_str()) != 0) { cerr << "Error: Could not enter " << dataDir << ".\n"; return 1; }
+
+    BenchSuite suite;
+    mt19937 gen(seed);
+    suite.measure("parse_edges_csv", loads, [](size_t) {
+        Graph graph;
+        graph.loadEdgesCsv(DATA_PATH);
+    });
+    struct stat csvInfo;
+    if (stat(DATA_PATH.c_str(), &csvInfo) == 0) {
+        Graph compiled;
+        compiled.loadEdgesCsv(DATA_PATH);
+        compiled.saveSnapshot(SNAPSHOT_FILE, csvInfo.st_size, csvInfo.st_mtime);
+        suite.measure("load_snapshot", loads, [&](size_t) {
+            Graph graph;
+            graph.loadSnapshot(SNAPSHOT_FILE, csvInfo.st_size, csvInfo.st_mtime);
+        });
+    }
+
+    Graph cityMap;
+    cityMap.loadEdgesCsv(DATA_PATH);
+    cityMap.loadCoordinatesCsv(COORDS_FILE);
+    cityMap.calibrateHeuristic();
+    cityMap.prepareHierarchy(HIERARCHY_FILE);
+    size_t n = cityMap.nodeCount();
+    if (n < 2) { cerr << "Error: Not enough locations in " << DATA_PATH << ".\n"; return 1; }
+    vector<pair<NodeId, NodeId>> pairs;
+    for (size_t i = 0; i < queries; i++) pairs.emplace_back(gen() % n, gen() % n);
+
+    const pair<SearchMode, const char*> modes[] = {{SearchMode::Dijkstra, "route_dijkstra"}, {SearchMode::Bidirectional, "route_bidirectional"},
+                                                   {SearchMode::AStar, "route_astar"}, {SearchMode::Hierarchy, "route_hierarchy"}};
+    for (auto [mode, label] : modes) {
+        cityMap.setSearchMode(mode);
+        suite.measure(label, queries, [&](size_t i) { cityMap.computePath(pairs[i].first, pairs[i].second); });
+    }
+    cityMap.setSearchMode(SearchMode::Hierarchy);
+    suite.measure("shortest_path_cached", queries, [&](size_t i) { cityMap.shortestPath(pairs[i].first, pairs[i].second); });
+
+    vector<string> prefixes, typos;
+    for (size_t i = 0; i < queries; i++) {
+        string name(cityMap.locationName(pairs[i].first));
+        prefixes.push_back(name.substr(0, 1 + gen() % name.size()));
+        name[gen() % name.size()] = static_cast<char>('a' + gen() % 26);
+        typos.push_back(name);
+    }
+    suite.measure("autocomplete_prefix", queries, [&](size_t i) { cityMap.suggestLocations(prefixes[i]); });
+    suite.measure("fuzzy_location", queries, [&](size_t i) { cityMap.suggestLocations(typos[i]); });
+
+    // The synthetic feed goes to the system temp directory so the data directory's live traffic_updates.csv is left alone.
+    string updatesPath = (filesystem::temp_directory_path() / ("rbs_bench_traffic_" + to_string(seed) + ".csv")).string();
+    ifstream edgeRows(DATA_PATH);
+    ofstream updates(updatesPath);
+    string row;
+    getline(edgeRows, row);
+    while (getline(edgeRows, row)) updates << row.substr(0, row.rfind(',')) << "," << uniform_real_distribution<float>(0.3f, 1.2f)(gen) << "\n";
+    updates.close();
+    time_t departure = time(0);
+    suite.measure("traffic_update_batch", loads, [&](size_t) { cityMap.applyTrafficUpdates(updatesPath, departure); });
+    suite.measure("traffic_eta_one_to_one", queries, [&](size_t i) { cityMap.travelMinutesTo(pairs[i].first, {pairs[i].second}, departure); });
+    remove(updatesPath.c_str());
+
+    DriverManager driverManager;
+    suite.measure("load_drivers", loads, [&](size_t) { driverManager.loadDrivers(); });
+    driverManager.attachMap(cityMap);
+    RideHistory rideHistory;
+    suite.measure("load_history", loads, [&](size_t) { rideHistory.loadHistory(); });
+
+    UserManager userManager;
+    RatingSystem ratingSystem;
+    ratingSystem.loadRatings();
+    BookingEngine engine(cityMap, driverManager, userManager, rideHistory, ratingSystem);
+    vector<string> phones = userManager.getPhones();
+    if (phones.empty()) { userManager.addUser("Bench Rider", "5550000000", "", "Cash"); phones.push_back("5550000000"); }
+    const char* vehicles[] = {"2-wheeler", "4-seater", "7-seater"};
+    vector<BookingRequest> requests;
+    for (size_t i = 0; i < queries; i++) {
+        requests.push_back({"Bench Rider", phones[i % phones.size()], string(cityMap.locationName(pairs[i].first)),
+                            string(cityMap.locationName(pairs[i].second)), vehicles[gen() % 3], "Cash"});
+    }
+    suite.measure("quote_with_drivers", queries, [&](size_t i) { engine.quote(requests[i]); });
+    SurgeEngine& surge = driverManager.surgePricing();
+    suite.measure("surge_record_and_price", queries, [&](size_t i) {
+        VehicleClass vehicle = vehicleClassOf(requests[i].vehicleType);
+        surge.recordRequest(pairs[i].first, vehicle, departure);
+        surge.multiplier(pairs[i].first, vehicle, departure);
+    });
+    suite.measure("available_drivers_scan", queries, [&](size_t i) { driverManager.availableDrivers(static_cast<VehicleClass>(i % VEHICLE_CLASSES)); });
+    suite.measure("dispatch_and_release", queries, [&](size_t i) {
+        BookingResult result = engine.dispatch(requests[i]);
+        engine.cancel(requests[i], result);
+    });
+    vector<BookingRequest> sharedRequests = requests;
+    vector<BookingResult> sharedResults(queries);
+    for (auto& request : sharedRequests) request.shared = true;
+    suite.measure("shared_dispatch", queries, [&](size_t i) { sharedResults[i] = engine.dispatch(sharedRequests[i]); });
+    for (size_t i = 0; i < queries; i++) engine.cancel(sharedRequests[i], sharedResults[i]);
+
+    suite.report(synthetic > 0 ? dataDir : "bundled", n, cityMap.edgeCount(), driverManager.getDriverCount(), rideHistory.getRideCount());
+    return 0;
+}
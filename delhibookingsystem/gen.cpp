@@ -0,0 +1,286 @@
+#define RBS_NO_MAIN
+#include "test2.cpp"
+#include <unordered_set>
+#ifdef _WIN32
+#include <direct.h>
+#define makeDirectory(path) _mkdir(path)
+#else
+#define makeDirectory(path) mkdir(path, 0755)
+#endif
+
+const double MIN_LAT = 28.40, MAX_LAT = 28.88, MIN_LON = 76.84, MAX_LON = 77.35;
+const float HOURLY_DEMAND[24] = {0.6f, 0.4f, 0.3f, 0.3f, 0.4f, 0.8f, 1.5f, 2.6f, 4.0f, 4.4f, 3.2f, 2.0f,
+                                 1.9f, 1.8f, 1.7f, 1.9f, 2.4f, 3.6f, 4.6f, 4.8f, 3.8f, 2.4f, 1.5f, 0.9f};
+
+struct Hub {
+    const char* name;
+    double lat, lon, spread;
+    bool business;
+};
+
+const Hub HUBS[] = {
+    {"Connaught Place", 28.6315, 77.2167, 0.020, true}, {"Nehru Place", 28.5491, 77.2533, 0.015, true},
+    {"Gurgaon Cyber City", 28.4950, 77.0890, 0.020, true}, {"Noida Sector 62", 28.6270, 77.3720, 0.020, true},
+    {"Karol Bagh", 28.6514, 77.1907, 0.015, true}, {"Saket", 28.5244, 77.2069, 0.018, false},
+    {"Dwarka", 28.5921, 77.0460, 0.030, false}, {"Rohini", 28.7495, 77.0565, 0.030, false},
+    {"Lajpat Nagar", 28.5677, 77.2433, 0.015, false}, {"Janakpuri", 28.6219, 77.0878, 0.020, false},
+    {"Mayur Vihar", 28.6090, 77.2940, 0.020, false}, {"Pitampura", 28.7033, 77.1322, 0.020, false},
+    {"Vasant Kunj", 28.5200, 77.1580, 0.020, false}, {"Shahdara", 28.6733, 77.2894, 0.020, false},
+    {"Narela", 28.8527, 77.0929, 0.025, false}, {"Okhla", 28.5355, 77.2910, 0.018, true},
+};
+const size_t HUB_COUNT = sizeof(HUBS) / sizeof(HUBS[0]);
+// Ride history covers the 90 days from this UTC midnight (2025-01-01) unless --start gives another epoch.
+const time_t HISTORY_START = 1735689600;
+
+class CityGenerator {
+private:
+    mt19937_64 gen;
+    vector<double> lat, lon;
+    vector<size_t> hubOf;
+    vector<string> names;
+    vector<pair<uint32_t, uint32_t>> roads;
+    double cellDeg = 0.01;
+    size_t gridRows = 0, gridCols = 0;
+    vector<vector<uint32_t>> grid;
+    static double kmBetween(double lat1, double lon1, double lat2, double lon2) {
+        return haversineKm((lat2 - lat1) * PI / 180, (lon2 - lon1) * PI / 180, cos(lat1 * PI / 180), cos(lat2 * PI / 180));
+    }
+    double km(uint32_t a, uint32_t b) const { return kmBetween(lat[a], lon[a], lat[b], lon[b]); }
+    size_t cellRow(double value) const { return min(gridRows - 1, static_cast<size_t>((value - MIN_LAT) / cellDeg)); }
+    size_t cellCol(double value) const { return min(gridCols - 1, static_cast<size_t>((value - MIN_LON) / cellDeg)); }
+    template <typename Visit>
+    void scanRing(uint32_t node, size_t ring, Visit&& visit) const {
+        long row = static_cast<long>(cellRow(lat[node])), col = static_cast<long>(cellCol(lon[node])), r = static_cast<long>(ring);
+        for (long dr = -r; dr <= r; dr++) {
+            for (long dc = -r; dc <= r; dc += (labs(dr) == r ? 1 : max(1L, 2 * r))) {
+                long y = row + dr, x = col + dc;
+                if (y < 0 || x < 0 || y >= static_cast<long>(gridRows) || x >= static_cast<long>(gridCols)) continue;
+                for (uint32_t other : grid[y * gridCols + x]) visit(other);
+            }
+        }
+    }
+    vector<uint32_t> nearest(uint32_t node, size_t k) const {
+        vector<pair<double, uint32_t>> found;
+        size_t maxRing = max(gridRows, gridCols);
+        for (size_t ring = 0; ring <= maxRing; ring++) {
+            scanRing(node, ring, [&](uint32_t other) { if (other != node) found.emplace_back(km(node, other), other); });
+            double ringKm = ring * cellDeg * 111.0 * cos(lat[node] * PI / 180);
+            if (found.size() >= k) {
+                partial_sort(found.begin(), found.begin() + k, found.end());
+                if (found[k - 1].first <= ringKm) break;
+            }
+        }
+        vector<uint32_t> result;
+        for (size_t i = 0; i < min(k, found.size()); i++) result.push_back(found[i].second);
+        return result;
+    }
+    static size_t findRoot(vector<size_t>& parent, size_t x) {
+        while (parent[x] != x) x = parent[x] = parent[parent[x]];
+        return x;
+    }
+public:
+    explicit CityGenerator(uint64_t seed) : gen(seed) {}
+    void placeLocations(size_t count) {
+        normal_distribution<double> offset(0.0, 1.0);
+        uniform_real_distribution<double> unit(0.0, 1.0);
+        vector<size_t> perHub(HUB_COUNT, 0);
+        for (size_t i = 0; i < count; i++) {
+            size_t hub = gen() % HUB_COUNT;
+            double y, x;
+            if (unit(gen) < 0.7) {
+                y = HUBS[hub].lat + offset(gen) * HUBS[hub].spread;
+                x = HUBS[hub].lon + offset(gen) * HUBS[hub].spread;
+            } else {
+                y = MIN_LAT + unit(gen) * (MAX_LAT - MIN_LAT);
+                x = MIN_LON + unit(gen) * (MAX_LON - MIN_LON);
+                double best = INF;
+                for (size_t h = 0; h < HUB_COUNT; h++) {
+                    double d = kmBetween(y, x, HUBS[h].lat, HUBS[h].lon);
+                    if (d < best) { best = d; hub = h; }
+                }
+            }
+            lat.push_back(min(MAX_LAT, max(MIN_LAT, y)));
+            lon.push_back(min(MAX_LON, max(MIN_LON, x)));
+            hubOf.push_back(hub);
+            names.push_back(string(HUBS[hub].name) + " Block " + to_string(++perHub[hub]));
+        }
+        cellDeg = sqrt((MAX_LAT - MIN_LAT) * (MAX_LON - MIN_LON) / max(size_t(1), count / 2));
+        gridRows = static_cast<size_t>((MAX_LAT - MIN_LAT) / cellDeg) + 1;
+        gridCols = static_cast<size_t>((MAX_LON - MIN_LON) / cellDeg) + 1;
+        grid.assign(gridRows * gridCols, {});
+        for (uint32_t i = 0; i < count; i++) grid[cellRow(lat[i]) * gridCols + cellCol(lon[i])].push_back(i);
+    }
+    void connectRoads(size_t degree) {
+        size_t n = lat.size();
+        unordered_set<uint64_t> seen;
+        vector<size_t> parent(n);
+        iota(parent.begin(), parent.end(), 0);
+        auto addRoad = [&](uint32_t a, uint32_t b) {
+            uint64_t key = (static_cast<uint64_t>(min(a, b)) << 32) | max(a, b);
+            if (a == b || !seen.insert(key).second) return;
+            roads.emplace_back(a, b);
+            parent[findRoot(parent, a)] = findRoot(parent, b);
+        };
+        for (uint32_t i = 0; i < n; i++) for (uint32_t other : nearest(i, degree)) addRoad(i, other);
+        unordered_map<size_t, vector<uint32_t>> components;
+        for (uint32_t i = 0; i < n; i++) components[findRoot(parent, i)].push_back(i);
+        while (components.size() > 1) {
+            auto smallest = min_element(components.begin(), components.end(),
+                                        [](const auto& a, const auto& b) { return a.second.size() < b.second.size(); });
+            size_t root = smallest->first;
+            double best = INF;
+            pair<uint32_t, uint32_t> bridge{0, 0};
+            for (uint32_t node : smallest->second) {
+                for (size_t ring = 0; ring <= max(gridRows, gridCols) && best == INF; ring++) {
+                    scanRing(node, ring, [&](uint32_t other) {
+                        if (findRoot(parent, other) != root && km(node, other) < best) { best = km(node, other); bridge = {node, other}; }
+                    });
+                }
+            }
+            size_t target = findRoot(parent, bridge.second);
+            addRoad(bridge.first, bridge.second);
+            auto& merged = components[target];
+            merged.insert(merged.end(), smallest->second.begin(), smallest->second.end());
+            components.erase(root);
+            if (findRoot(parent, target) != target) {
+                components[findRoot(parent, target)] = move(merged);
+                components.erase(target);
+            }
+        }
+    }
+    void writeCity(const string& dir) {
+        ofstream edges(dir + "/" + DATA_PATH), coords(dir + "/" + COORDS_FILE);
+        uniform_real_distribution<double> detour(1.1, 1.45);
+        edges << "From,To,Distance(km)\n" << fixed << setprecision(2);
+        for (auto [a, b] : roads) edges << names[a] << "," << names[b] << "," << max(0.05, km(a, b) * detour(gen)) << "\n";
+        coords << "Location,Latitude,Longitude\n" << fixed << setprecision(5);
+        for (size_t i = 0; i < names.size(); i++) coords << names[i] << "," << lat[i] << "," << lon[i] << "\n";
+    }
+    uint32_t randomLocation(bool business) {
+        for (int attempt = 0; attempt < 8; attempt++) {
+            uint32_t node = gen() % names.size();
+            if (HUBS[hubOf[node]].business == business) return node;
+        }
+        return gen() % names.size();
+    }
+    uint32_t tripOrigin(int hour) { return randomLocation(hour >= 12 && hour < 22 && gen() % 3 != 0); }
+    uint32_t tripDestination(int hour) { return randomLocation(hour < 12 && gen() % 3 != 0); }
+    int demandHour() {
+        discrete_distribution<int> hours(begin(HOURLY_DEMAND), end(HOURLY_DEMAND));
+        return hours(gen);
+    }
+    const string& name(uint32_t node) const { return names[node]; }
+    double tripKm(uint32_t a, uint32_t b) const { return km(a, b) * 1.3; }
+    mt19937_64& random() { return gen; }
+    size_t roadCount() const { return roads.size(); }
+};
+
+string ctimeString(time_t when) {
+    tm utc{};
+#ifdef _WIN32
+    gmtime_s(&utc, &when);
+#else
+    gmtime_r(&when, &utc);
+#endif
+    char buffer[32];
+    strftime(buffer, sizeof(buffer), "%a %b %e %H:%M:%S %Y", &utc);
+    return buffer;
+}
+
+struct SyntheticOptions {
+    string outDir = "synthetic_city";
+    size_t locations = 100000, drivers = 20000, users = 50000, rides = 1000000, bookings = 200000, degree = 3;
+    uint64_t seed = 42;
+    time_t start = HISTORY_START;
+};
+
+// Writes a full synthetic data set into options.outDir; bench.cpp reuses this for --synthetic.
+bool writeSyntheticData(const SyntheticOptions& options, ostream& log) {
+    const string& outDir = options.outDir;
+    size_t locations = options.locations, drivers = options.drivers, users = options.users, rides = options.rides,
+           bookings = options.bookings;
+    time_t start = options.start;
+    if (locations < 2 || users == 0) { cerr << "Error: Need at least 2 locations and 1 user.\n"; return false; }
+    makeDirectory(outDir.c_str());
+    CityGenerator city(options.seed);
+    mt19937_64& gen = city.random();
+    const char* vehicles[] = {"2-wheeler", "4-seater", "7-seater"};
+    const float rates[] = {10.0f, 15.0f, 20.0f};
+    discrete_distribution<int> vehicleMix({5, 4, 1});
+
+    city.placeLocations(locations);
+    city.connectRoads(options.degree);
+    city.writeCity(outDir);
+    log << "Wrote " << locations << " locations and " << city.roadCount() << " roads.\n";
+
+    ofstream driverFile(outDir + "/" + DRIVERS_FILE);
+    for (size_t i = 0; i < drivers; i++) {
+        driverFile << "Driver " << i + 1 << "," << 9000000000ULL + i << "," << city.name(gen() % locations) << ","
+                   << vehicles[vehicleMix(gen)] << "," << (gen() % 10 < 8 ? 1 : 0) << "\n";
+    }
+    ofstream userFile(outDir + "/" + USER_ACCOUNTS);
+    for (size_t i = 0; i < users; i++) {
+        bool wallet = gen() % 2;
+        userFile << "Rider " << i + 1 << "," << 7000000000ULL + i << ",rider" << i + 1 << "@example.com,"
+                 << (wallet ? "Wallet" : "Cash") << "," << (wallet ? static_cast<int>(gen() % 2000) : 0) << "\n";
+    }
+    log << "Wrote " << drivers << " drivers and " << users << " users.\n";
+
+    map<size_t, pair<float, int>> ratings;
+    ofstream historyFile(outDir + "/" + RIDE_HISTORY);
+    historyFile << "BookingID,User,UserPhone,Source,Destination,VehicleType,Fare,Driver,DriverPhone,Timestamp,Rating\n";
+    start -= start % (24 * 3600);
+    for (size_t i = 0; i < rides; i++) {
+        int hour = city.demandHour(), vehicle = vehicleMix(gen);
+        uint32_t from = city.tripOrigin(hour), to = city.tripDestination(hour);
+        size_t rider = gen() % users, driver = drivers ? gen() % drivers : 0;
+        bool peak = (hour >= 17 && hour <= 20) || (hour >= 8 && hour <= 10);
+        float fare = rates[vehicle] * city.tripKm(from, to) * (peak ? 1.25f : 1.0f);
+        int rating = gen() % 10 < 7 ? 3 + static_cast<int>(gen() % 3) : 0;
+        time_t when = start + (gen() % 90) * 24 * 3600 + hour * 3600 + gen() % 3600;
+        historyFile << "SB" << setw(8) << setfill('0') << i << setfill(' ') << ",Rider " << rider + 1 << ","
+                    << 7000000000ULL + rider << "," << city.name(from) << "," << city.name(to) << ","
+                    << vehicles[vehicle] << "," << fixed << setprecision(2) << fare << ",";
+        if (drivers) historyFile << "Driver " << driver + 1 << "," << 9000000000ULL + driver;
+        else historyFile << ",";
+        historyFile << "," << ctimeString(when) << "," << (rating ? to_string(rating) : "") << "\n";
+        if (drivers && rating) { ratings[driver].first += rating; ratings[driver].second++; }
+    }
+    ofstream ratingFile(outDir + "/" + DRIVER_RATINGS);
+    for (const auto& [driver, total] : ratings) ratingFile << 9000000000ULL + driver << "," << total.first << "," << total.second << "\n";
+    log << "Wrote " << rides << " ride history rows.\n";
+
+    vector<tuple<uint32_t, uint32_t, uint32_t, size_t, int>> trace;
+    for (size_t i = 0; i < bookings; i++) {
+        int hour = city.demandHour();
+        trace.emplace_back(hour * 3600 + gen() % 3600, city.tripOrigin(hour), city.tripDestination(hour), gen() % users, vehicleMix(gen));
+    }
+    sort(trace.begin(), trace.end());
+    ofstream traceFile(outDir + "/" + BOOKING_TRACE);
+    traceFile << "Second,UserPhone,Source,Destination,VehicleType\n";
+    for (const auto& [second, from, to, rider, vehicle] : trace) {
+        traceFile << second << "," << 7000000000ULL + rider << "," << city.name(from) << "," << city.name(to) << "," << vehicles[vehicle] << "\n";
+    }
+    log << "Wrote " << bookings << " booking requests to " << BOOKING_TRACE << ".\n";
+    return true;
+}
+
+#ifndef RBS_GEN_NO_MAIN
+int main(int argc, char* argv[]) {
+    SyntheticOptions options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string flag = argv[i];
+        if (flag == "--out") options.outDir = argv[i + 1];
+        else if (flag == "--locations") options.locations = stoul(argv[i + 1]);
+        else if (flag == "--drivers") options.drivers = stoul(argv[i + 1]);
+        else if (flag == "--users") options.users = stoul(argv[i + 1]);
+        else if (flag == "--rides") options.rides = stoul(argv[i + 1]);
+        else if (flag == "--bookings") options.bookings = stoul(argv[i + 1]);
+        else if (flag == "--degree") options.degree = max<size_t>(1, stoul(argv[i + 1]));
+        else if (flag == "--seed") options.seed = stoull(argv[i + 1]);
+        else if (flag == "--start") options.start = static_cast<time_t>(stoll(argv[i + 1]));
+        else { cerr << "Unknown option " << flag << "\n"; return 1; }
+    }
+    return writeSyntheticData(options, cout) ? 0 : 1;
+}
+#endif
@@ -2,8 +2,12 @@
 #include <fstream>
 #include <sstream>
 #include <map>
+#include <list>
+#include <memory>
 #include <unordered_map>
 #include <vector>
+#include <array>
+#include <bitset>
 #include <queue>
 #include <set>
 #include <limits>
@@ -13,21 +17,79 @@
 #include <random>
 #include <chrono>
 #include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <future>
+#include <atomic>
+#include <condition_variable>
 #include <ctime>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <numeric>
+#include <deque>
+#include <string_view>
+#include <charconv>
+#include <cstdio>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
 const float INF = numeric_limits<float>::infinity();
 const string DATA_PATH = "delhi_location_edges.csv";
+const string HIERARCHY_FILE = "delhi_location_edges.ch";
+const string SNAPSHOT_FILE = "delhi_location_edges.bin";
+const string COORDS_FILE = "delhi_location_coords.csv";
 const string DRIVERS_FILE = "registered_drivers.csv";
 const string RIDE_HISTORY = "ride_history.csv";
+const string RIDE_JOURNAL = "ride_history.log";
 const string USER_ACCOUNTS = "user_accounts.csv";
 const string DRIVER_RATINGS = "driver_ratings.csv";
+const size_t DRIVER_CANDIDATES = 3;
+const float MAX_PICKUP_KM = 40.0f;
+const size_t PATH_CACHE_BYTES = 64 << 20;
+const chrono::milliseconds PERSIST_INTERVAL(200);
+const size_t PERSIST_BATCH_SIZE = 64;
+const chrono::milliseconds BATCH_WINDOW(200);
+const size_t BATCH_CANDIDATES = 32;
+const size_t HISTORY_PAGE_SIZE = 5;
+const string TRAFFIC_PROFILES = "traffic_profiles.csv";
+const string TRAFFIC_UPDATES = "traffic_updates.csv";
+const chrono::seconds TRAFFIC_POLL_INTERVAL(2);
+const int64_t TRAFFIC_UPDATE_TTL = 30 * 60;
+const size_t SUGGESTION_LIMIT = 5;
+const string METRICS_FILE = "metrics.prom";
+const chrono::seconds METRICS_DUMP_INTERVAL(15);
+const float SURGE_ZONE_DEG = 0.05f;
+const chrono::seconds SURGE_WINDOW(10 * 60);
+const size_t SURGE_MIN_REQUESTS = 3;
+const float SURGE_STEP = 0.25f;
+const float SURGE_CAP = 2.5f;
+const string BOOKING_TRACE = "booking_trace.csv";
+const int64_t SIM_MAX_WAIT_SECONDS = 10 * 60;
+const float POOL_MAX_DETOUR = 0.5f;
+const float POOL_FARE_FACTOR = 0.75f;
+const float POOL_PICKUP_SLACK_KM = 3.0f;
+const size_t POOL_DISPATCH_ATTEMPTS = 3;
 
 const float PI = 3.14159265358979323846;
 
-string normalize(const string& s) {
+// Great-circle km from latitude/longitude deltas and the two latitude cosines, all in radians.
+template <typename T>
+T haversineKm(T dLat, T dLon, T cosLat1, T cosLat2) {
+    T h = sin(dLat / 2) * sin(dLat / 2) + cosLat1 * cosLat2 * sin(dLon / 2) * sin(dLon / 2);
+    return 6371 * 2 * atan2(sqrt(h), sqrt(1 - h));
+}
+
+string normalize(string_view s) {
     string res;
     for (char c : s) {
         if (!isspace(c)) res += tolower(c);
@@ -35,414 +97,4043 @@ string normalize(const string& s) {
     return res;
 }
 
+enum class Metric { GraphLoad, ShortestPath, DriverCandidates, PoolInsertion, Payment, SaveDrivers, SaveUsers, SaveHistory, SaveRatings, Count };
+enum class Counter { NodesSettled, EdgesRelaxed, CandidatesScanned, Count };
+
+class Metrics {
+public:
+    static const size_t TIMERS = static_cast<size_t>(Metric::Count), COUNTERS = static_cast<size_t>(Counter::Count);
+    static const size_t BUCKETS = 22;
+    static constexpr double BUCKET_MICROS[BUCKETS] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1e3, 2e3, 5e3, 1e4, 2e4, 5e4,
+                                                      1e5, 2e5, 5e5, 1e6, 2e6, 5e6, 1e7};
+    struct Timer {
+        uint64_t count = 0, nanos = 0;
+        array<uint64_t, BUCKETS + 1> buckets{};
+        double meanMicros() const { return count ? nanos / 1000.0 / count : 0.0; }
+        double percentileMicros(double p) const {
+            uint64_t rank = static_cast<uint64_t>(ceil(p / 100.0 * count)), seen = 0;
+            for (size_t b = 0; b < BUCKETS; b++) if ((seen += buckets[b]) >= max(rank, uint64_t(1))) return BUCKET_MICROS[b];
+            return count ? INFINITY : 0.0;
+        }
+    };
+    struct Snapshot {
+        array<Timer, TIMERS> timers;
+        array<uint64_t, COUNTERS> counters{};
+    };
+private:
+    // Each thread writes only its own shard, so updates are plain relaxed stores; readers sum the shards.
+    struct Shard {
+        array<array<atomic<uint64_t>, BUCKETS + 1>, TIMERS> buckets{};
+        array<atomic<uint64_t>, TIMERS> nanos{};
+        array<atomic<uint64_t>, COUNTERS> counters{};
+    };
+    static mutex& registryMutex() {
+        static mutex registry;
+        return registry;
+    }
+    static vector<unique_ptr<Shard>>& shards() {
+        static vector<unique_ptr<Shard>> all;
+        return all;
+    }
+    static Shard& local() {
+        thread_local Shard* shard = [] {
+            lock_guard<mutex> lock(registryMutex());
+            shards().push_back(make_unique<Shard>());
+            return shards().back().get();
+        }();
+        return *shard;
+    }
+    static void bump(atomic<uint64_t>& cell, uint64_t by) { cell.store(cell.load(memory_order_relaxed) + by, memory_order_relaxed); }
+public:
+    static void record(Metric metric, chrono::nanoseconds elapsed) {
+        Shard& shard = local();
+        size_t m = static_cast<size_t>(metric), b = 0;
+        double micros = elapsed.count() / 1000.0;
+        while (b < BUCKETS && micros > BUCKET_MICROS[b]) b++;
+        bump(shard.buckets[m][b], 1);
+        bump(shard.nanos[m], static_cast<uint64_t>(elapsed.count()));
+    }
+    static void add(Counter counter, uint64_t by = 1) { bump(local().counters[static_cast<size_t>(counter)], by); }
+    static Snapshot snapshot() {
+        Snapshot total;
+        lock_guard<mutex> lock(registryMutex());
+        for (const auto& shard : shards()) {
+            for (size_t m = 0; m < TIMERS; m++) {
+                for (size_t b = 0; b <= BUCKETS; b++) {
+                    uint64_t hits = shard->buckets[m][b].load(memory_order_relaxed);
+                    total.timers[m].buckets[b] += hits;
+                    total.timers[m].count += hits;
+                }
+                total.timers[m].nanos += shard->nanos[m].load(memory_order_relaxed);
+            }
+            for (size_t c = 0; c < COUNTERS; c++) total.counters[c] += shard->counters[c].load(memory_order_relaxed);
+        }
+        return total;
+    }
+    static const char* name(Metric metric) {
+        static const char* names[TIMERS] = {"graph_load", "shortest_path", "driver_candidates", "pool_insertion", "payment",
+                                            "save_drivers", "save_users", "save_history", "save_ratings"};
+        return names[static_cast<size_t>(metric)];
+    }
+    static const char* name(Counter counter) {
+        static const char* names[COUNTERS] = {"nodes_settled", "edges_relaxed", "candidates_scanned"};
+        return names[static_cast<size_t>(counter)];
+    }
+    static string prometheusText() {
+        Snapshot current = snapshot();
+        ostringstream out;
+        out << "# HELP rbs_operation_seconds Latency of instrumented operations.\n# TYPE rbs_operation_seconds histogram\n";
+        for (size_t m = 0; m < TIMERS; m++) {
+            const Timer& timer = current.timers[m];
+            string label = string("{op=\"") + name(static_cast<Metric>(m)) + "\"";
+            uint64_t cumulative = 0;
+            for (size_t b = 0; b < BUCKETS; b++) {
+                cumulative += timer.buckets[b];
+                out << "rbs_operation_seconds_bucket" << label << ",le=\"" << BUCKET_MICROS[b] / 1e6 << "\"} " << cumulative << "\n";
+            }
+            out << "rbs_operation_seconds_bucket" << label << ",le=\"+Inf\"} " << timer.count << "\n";
+            out << "rbs_operation_seconds_sum" << label << "} " << timer.nanos / 1e9 << "\n";
+            out << "rbs_operation_seconds_count" << label << "} " << timer.count << "\n";
+        }
+        for (size_t c = 0; c < COUNTERS; c++) {
+            string metric = string("rbs_") + name(static_cast<Counter>(c)) + "_total";
+            out << "# TYPE " << metric << " counter\n" << metric << " " << current.counters[c] << "\n";
+        }
+        return out.str();
+    }
+    static bool dump(const string& path) {
+        string tempPath = path + ".tmp";
+        {
+            ofstream fout(tempPath);
+            if (!fout.is_open()) return false;
+            fout << prometheusText();
+            if (!fout) return false;
+        }
+        return rename(tempPath.c_str(), path.c_str()) == 0;
+    }
+};
+
+class ScopedTimer {
+private:
+    Metric metric;
+    chrono::steady_clock::time_point start;
+public:
+    explicit ScopedTimer(Metric timed) : metric(timed), start(chrono::steady_clock::now()) {}
+    ~ScopedTimer() { Metrics::record(metric, chrono::steady_clock::now() - start); }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+};
+
+class MetricsDumper {
+private:
+    string path;
+    mutex stateMutex;
+    condition_variable wake;
+    bool stopping = false;
+    thread worker;
+public:
+    MetricsDumper(const string& file, chrono::seconds interval) : path(file) {
+        worker = thread([this, interval] {
+            unique_lock<mutex> lock(stateMutex);
+            while (!wake.wait_for(lock, interval, [this] { return stopping; })) Metrics::dump(path);
+        });
+    }
+    ~MetricsDumper() {
+        {
+            lock_guard<mutex> lock(stateMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        worker.join();
+        Metrics::dump(path);
+    }
+};
+
+class MappedFile {
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    vector<char> buffer;
+#endif
+public:
+    MappedFile() {}
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+    bool open(const string& path) {
+        close();
+#ifdef _WIN32
+        ifstream fin(path, ios::binary);
+        if (!fin.is_open()) return false;
+        buffer.assign(istreambuf_iterator<char>(fin), istreambuf_iterator<char>());
+        bytes = buffer.data(); length = buffer.size();
+        return true;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) { ::close(fd); return false; }
+        void* addr = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) return false;
+        bytes = static_cast<const char*>(addr); length = info.st_size;
+        return true;
+#endif
+    }
+    void close() {
+#ifndef _WIN32
+        if (bytes) munmap(const_cast<char*>(bytes), length);
+#endif
+        bytes = nullptr; length = 0;
+    }
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+};
+
+template <typename T>
+struct ArrayView {
+    const T* ptr = nullptr;
+    size_t count = 0;
+    ArrayView() {}
+    ArrayView(const vector<T>& values) : ptr(values.data()), count(values.size()) {}
+    ArrayView(const T* p, size_t c) : ptr(p), count(c) {}
+    const T& operator[](size_t i) const { return ptr[i]; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T* begin() const { return ptr; }
+    const T* end() const { return ptr + count; }
+};
+
+class StringArena {
+private:
+    static const size_t BLOCK_SIZE = 64 * 1024;
+    struct Slot {
+        size_t hash = 0;
+        string_view text;
+    };
+    vector<unique_ptr<char[]>> blocks;
+    size_t used = BLOCK_SIZE, stored = 0, count = 0;
+    // Open addressing keeps the hash beside the view, so most probes never touch the string bytes.
+    vector<Slot> slots = vector<Slot>(1024);
+    mutable mutex arenaMutex;
+    void grow() {
+        vector<Slot> larger(slots.size() * 2);
+        for (const Slot& slot : slots) {
+            if (slot.text.empty()) continue;
+            size_t i = slot.hash & (larger.size() - 1);
+            while (!larger[i].text.empty()) i = (i + 1) & (larger.size() - 1);
+            larger[i] = slot;
+        }
+        slots.swap(larger);
+    }
+    string_view store(string_view text) {
+        char* target;
+        if (text.size() > BLOCK_SIZE / 4) {
+            blocks.insert(blocks.begin(), make_unique<char[]>(text.size()));
+            target = blocks.front().get();
+        } else {
+            if (text.size() > BLOCK_SIZE - used) { blocks.push_back(make_unique<char[]>(BLOCK_SIZE)); used = 0; }
+            target = blocks.back().get() + used;
+            used += text.size();
+        }
+        memcpy(target, text.data(), text.size());
+        stored += text.size();
+        return string_view(target, text.size());
+    }
+public:
+    string_view intern(string_view text) {
+        if (text.empty()) return string_view();
+        size_t hash = std::hash<string_view>()(text);
+        lock_guard<mutex> lock(arenaMutex);
+        size_t i = hash & (slots.size() - 1);
+        for (; !slots[i].text.empty(); i = (i + 1) & (slots.size() - 1)) {
+            if (slots[i].hash == hash && slots[i].text == text) return slots[i].text;
+        }
+        slots[i] = {hash, store(text)};
+        string_view interned = slots[i].text;
+        if (++count * 2 > slots.size()) grow();
+        return interned;
+    }
+    size_t size() const {
+        lock_guard<mutex> lock(arenaMutex);
+        return count;
+    }
+    size_t bytes() const {
+        lock_guard<mutex> lock(arenaMutex);
+        return stored;
+    }
+};
+
+StringArena& sharedStrings() {
+    static StringArena arena;
+    return arena;
+}
+
+class CsvReader {
+public:
+    static const size_t MAX_FIELDS = 32;
+private:
+    static const size_t MAX_REPORTED = 5;
+    MappedFile file;
+    string path;
+    const char* cursor = nullptr;
+    const char* limit = nullptr;
+    string_view current;
+    array<string_view, MAX_FIELDS> fields;
+    size_t fieldCount = 0, lineNumber = 0, rejected = 0;
+    static string_view trim(string_view text) {
+        while (!text.empty() && isspace(static_cast<unsigned char>(text.front()))) text.remove_prefix(1);
+        while (!text.empty() && isspace(static_cast<unsigned char>(text.back()))) text.remove_suffix(1);
+        return text;
+    }
+public:
+    CsvReader() {}
+    CsvReader(const CsvReader&) = delete;
+    CsvReader& operator=(const CsvReader&) = delete;
+    ~CsvReader() {
+        if (rejected > MAX_REPORTED) cerr << "Warning: Skipped " << rejected << " malformed row(s) in " << path << ".\n";
+    }
+    static size_t split(string_view line, string_view* out, size_t maxFields) {
+        size_t count = 0;
+        while (count < maxFields) {
+            size_t comma = line.find(',');
+            out[count++] = line.substr(0, comma);
+            if (comma == string_view::npos) break;
+            line.remove_prefix(comma + 1);
+        }
+        return count;
+    }
+    template <typename T>
+    static bool parse(string_view text, T& value) {
+        text = trim(text);
+        if (!text.empty() && text.front() == '+') text.remove_prefix(1);
+        auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+        return !text.empty() && error == errc() && end == text.data() + text.size();
+    }
+    bool open(const string& filePath, bool hasHeader) {
+        path = filePath;
+        lineNumber = rejected = 0;
+        if (!file.open(path)) return false;
+        cursor = file.data();
+        limit = cursor + file.size();
+        if (hasHeader) next();
+        return true;
+    }
+    bool next() {
+        while (cursor < limit) {
+            const char* end = static_cast<const char*>(memchr(cursor, '\n', limit - cursor));
+            if (!end) end = limit;
+            current = string_view(cursor, end - cursor);
+            cursor = end < limit ? end + 1 : limit;
+            lineNumber++;
+            if (!current.empty() && current.back() == '\r') current.remove_suffix(1);
+            if (trim(current).empty()) continue;
+            fieldCount = split(current, fields.data(), MAX_FIELDS);
+            return true;
+        }
+        return false;
+    }
+    size_t size() const { return fieldCount; }
+    size_t fileSize() const { return file.size(); }
+    string_view operator[](size_t i) const { return i < fieldCount ? fields[i] : string_view(); }
+    template <typename T>
+    bool parse(size_t i, T& value) const { return parse((*this)[i], value); }
+    string_view row() const { return current; }
+    size_t line() const { return lineNumber; }
+    void reject(const string& reason) {
+        if (rejected++ < MAX_REPORTED) cerr << "Warning: " << path << " line " << lineNumber << ": " << reason << "\n";
+    }
+    size_t rejectedRows() const { return rejected; }
+};
+
+bool syncFile(FILE* file) {
+    if (fflush(file) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+void syncDirectory(const string& path) {
+#ifndef _WIN32
+    size_t slash = path.rfind('/');
+    string dir = slash == string::npos ? "." : path.substr(0, slash);
+    int fd = ::open(dir.c_str(), O_RDONLY);
+    if (fd >= 0) { fsync(fd); ::close(fd); }
+#endif
+}
+
+class GroupCommitWriter {
+private:
+    // Latest line per key, in the order keys were first written, so compaction keeps the file order.
+    struct KeyedLines {
+        unordered_map<string, size_t> slots;
+        vector<pair<string, string>> lines;
+        void put(const string& key, string line) {
+            auto [it, added] = slots.emplace(key, lines.size());
+            if (added) lines.emplace_back(key, move(line));
+            else lines[it->second].second = move(line);
+        }
+        size_t size() const { return lines.size(); }
+        bool empty() const { return lines.empty(); }
+        void clear() { slots.clear(); lines.clear(); }
+        void swap(KeyedLines& other) { slots.swap(other.slots); lines.swap(other.lines); }
+    };
+    string path;
+    Metric metric;
+    chrono::milliseconds interval;
+    size_t batchSize;
+    KeyedLines pending;
+    KeyedLines persisted;
+    size_t appendedSinceCompaction = 0;
+    bool stopping = false;
+    mutex stateMutex, ioMutex;
+    condition_variable wake;
+    thread worker;
+    bool compactLocked() {
+        string tempPath = path + ".tmp";
+        FILE* file = fopen(tempPath.c_str(), "wb");
+        if (!file) {
+            cerr << "Error: Could not open " << tempPath << " for writing.\n";
+            return false;
+        }
+        string buffer;
+        for (const auto& [key, line] : persisted.lines) { buffer += line; buffer += '\n'; }
+        bool written = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size() && syncFile(file);
+        if (fclose(file) != 0) written = false;
+        if (!written || rename(tempPath.c_str(), path.c_str()) != 0) {
+            cerr << "Error: Could not rewrite " << path << ".\n";
+            remove(tempPath.c_str());
+            return false;
+        }
+        syncDirectory(path);
+        appendedSinceCompaction = 0;
+        return true;
+    }
+    // Runs under ioMutex, so a batch taken from pending is on disk before replaceAll can rewrite the file.
+    // A failed batch goes back in front of pending, where newer upserts for the same key still win.
+    bool writePendingLocked() {
+        KeyedLines batch;
+        {
+            lock_guard<mutex> lock(stateMutex);
+            batch.swap(pending);
+        }
+        if (batch.empty()) return true;
+        ScopedTimer timer(metric);
+        FILE* file = fopen(path.c_str(), "ab");
+        bool written = file != nullptr;
+        if (file) {
+            string buffer;
+            for (const auto& [key, line] : batch.lines) { buffer += line; buffer += '\n'; }
+            written = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size() && syncFile(file);
+            if (fclose(file) != 0) written = false;
+        }
+        if (!written) {
+            cerr << "Error: Could not write " << batch.size() << " updates to " << path << ".\n";
+            lock_guard<mutex> lock(stateMutex);
+            for (auto& [key, line] : pending.lines) batch.put(key, move(line));
+            pending.swap(batch);
+            return false;
+        }
+        for (auto& [key, line] : batch.lines) persisted.put(key, move(line));
+        appendedSinceCompaction += batch.size();
+        if (appendedSinceCompaction > max(persisted.size(), PERSIST_BATCH_SIZE)) compactLocked();
+        return true;
+    }
+    void run() {
+        while (true) {
+            {
+                unique_lock<mutex> lock(stateMutex);
+                wake.wait_for(lock, interval, [this] { return stopping || pending.size() >= batchSize; });
+                if (pending.empty()) {
+                    if (stopping) return;
+                    continue;
+                }
+            }
+            bool written;
+            {
+                lock_guard<mutex> lock(ioMutex);
+                written = writePendingLocked();
+            }
+            if (written) continue;
+            unique_lock<mutex> lock(stateMutex);
+            if (stopping) {
+                cerr << "Error: " << pending.size() << " updates to " << path << " were not saved.\n";
+                return;
+            }
+            wake.wait_for(lock, interval, [this] { return stopping; });
+        }
+    }
+public:
+    GroupCommitWriter(const string& file, Metric timed, chrono::milliseconds flushInterval, size_t maxBatch)
+        : path(file), metric(timed), interval(flushInterval), batchSize(maxBatch) {
+        worker = thread([this] { run(); });
+    }
+    ~GroupCommitWriter() {
+        {
+            lock_guard<mutex> lock(stateMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        worker.join();
+    }
+    void seed(const vector<pair<string, string>>& records) {
+        lock_guard<mutex> lock(ioMutex);
+        persisted.clear();
+        for (const auto& [key, line] : records) persisted.put(key, line);
+        appendedSinceCompaction = 0;
+    }
+    void upsert(const string& key, const string& line) {
+        lock_guard<mutex> lock(stateMutex);
+        pending.put(key, line);
+        if (pending.size() >= batchSize) wake.notify_one();
+    }
+    // Upserts still queued are newer than the caller's snapshot, so they are folded in rather than dropped.
+    bool replaceAll(const vector<pair<string, string>>& records) {
+        lock_guard<mutex> lock(ioMutex);
+        ScopedTimer timer(metric);
+        persisted.clear();
+        for (const auto& [key, line] : records) persisted.put(key, line);
+        {
+            lock_guard<mutex> stateLock(stateMutex);
+            for (auto& [key, line] : pending.lines) persisted.put(key, move(line));
+            pending.clear();
+        }
+        return compactLocked();
+    }
+    bool flush() {
+        lock_guard<mutex> lock(ioMutex);
+        return writePendingLocked();
+    }
+};
+
 class RatingSystem {
 private:
     map<string, pair<float, int>> driverRatings;
+    mutable mutex ratingsMutex;
 public:
     void loadRatings() {
-        ifstream fin(DRIVER_RATINGS);
-        if (!fin.is_open()) return;
-        string line;
-        while (getline(fin, line)) {
-            stringstream ss(line);
-            string phone, ratingStr, countStr;
-            getline(ss, phone, ',');
-            getline(ss, ratingStr, ',');
-            getline(ss, countStr, ',');
-            try {
-                float rating = stof(ratingStr);
-                int count = stoi(countStr);
-                driverRatings[phone] = {rating, count};
-            } catch (...) { continue; }
-        }
-        fin.close();
+        lock_guard<mutex> lock(ratingsMutex);
+        CsvReader csv;
+        if (!csv.open(DRIVER_RATINGS, false)) return;
+        while (csv.next()) {
+            float rating;
+            int count;
+            if (csv[0].empty() || !csv.parse(1, rating) || !csv.parse(2, count)) { csv.reject("expected phone,rating,count"); continue; }
+            driverRatings[string(csv[0])] = {rating, count};
+        }
+    }
+    void addRating(const string& driverPhone, float rating) {
+        if (rating < 1 || rating > 5) return;
+        lock_guard<mutex> lock(ratingsMutex);
+        auto& [total, count] = driverRatings[driverPhone];
+        total += rating;
+        count++;
+    }
+    float getAverageRating(const string& driverPhone) const {
+        lock_guard<mutex> lock(ratingsMutex);
+        auto it = driverRatings.find(driverPhone);
+        if (it == driverRatings.end()) return 0.0f;
+        auto [total, count] = it->second;
+        return count > 0 ? total / count : 0.0f;
+    }
+    void saveRatings() {
+        lock_guard<mutex> lock(ratingsMutex);
+        ScopedTimer timer(Metric::SaveRatings);
+        ofstream fout(DRIVER_RATINGS);
+        if (!fout.is_open()) {
+            cerr << "Error: Could not open " << DRIVER_RATINGS << " for writing.\n";
+            return;
+        }
+        for (const auto& [phone, ratingData] : driverRatings) {
+            fout << phone << "," << ratingData.first << "," << ratingData.second << "\n";
+        }
+        fout.close();
+    }
+    void displayDriverRating(const string& driverPhone) {
+        float rating = getAverageRating(driverPhone);
+        cout << "Driver Rating: ";
+        if (rating == 0) cout << "No ratings yet\n";
+        else cout << fixed << setprecision(1) << rating << "/5 (" << string(static_cast<int>(round(rating)), '*') << ")\n";
+    }
+};
+
+class UserAccount {
+private:
+    string_view username, email, paymentMethod;
+    string phone;
+    float walletBalance;
+public:
+    UserAccount() : walletBalance(0.0f) {}
+    UserAccount(string_view uname, string_view ph, string_view em, string_view pm, float bal)
+        : username(sharedStrings().intern(uname)), email(sharedStrings().intern(em)), paymentMethod(sharedStrings().intern(pm)),
+          phone(ph), walletBalance(bal) {}
+    void displayProfile() const {
+        cout << "\n=== User Profile ===\nName: " << username << "\nPhone: " << phone 
+             << "\nEmail: " << (email.empty() ? "Not provided" : email)
+             << "\nPayment Method: " << paymentMethod << "\nWallet Balance: RS " 
+             << fixed << setprecision(2) << walletBalance << "\n";
+    }
+    bool makePayment(float amount) {
+        if (walletBalance >= amount) { walletBalance -= amount; return true; }
+        return false;
+    }
+    void addToWallet(float amount) { walletBalance += amount; }
+    float getBalance() const { return walletBalance; }
+    string getPaymentMethod() const { return string(paymentMethod); }
+    void updatePaymentMethod(const string& newMethod) { paymentMethod = sharedStrings().intern(newMethod); }
+    const string& getPhone() const { return phone; }
+    string csvLine() const {
+        ostringstream out;
+        out << username << "," << phone << "," << email << "," << paymentMethod << "," << walletBalance;
+        return out.str();
+    }
+};
+
+class UserManager {
+private:
+    static const size_t WALLET_SHARDS = 16;
+    unordered_map<string, UserAccount> users;
+    mutable shared_mutex accountsMutex;
+    array<mutex, WALLET_SHARDS> walletLocks;
+    GroupCommitWriter writer{USER_ACCOUNTS, Metric::SaveUsers, PERSIST_INTERVAL, PERSIST_BATCH_SIZE};
+    mutex& walletLock(const string& phone) { return walletLocks[hash<string>{}(phone) % WALLET_SHARDS]; }
+public:
+    UserManager() { loadUsers(); }
+    void loadUsers() {
+        unique_lock<shared_mutex> lock(accountsMutex);
+        CsvReader csv;
+        if (!csv.open(USER_ACCOUNTS, false)) return;
+        vector<pair<string, string>> lines;
+        while (csv.next()) {
+            float balance;
+            if (csv[1].empty() || !csv.parse(4, balance)) { csv.reject("expected name,phone,email,payment method,balance"); continue; }
+            string phone(csv[1]);
+            auto it = users.insert_or_assign(phone, UserAccount(csv[0], phone, csv[2], csv[3], balance)).first;
+            lines.emplace_back(phone, it->second.csvLine());
+        }
+        writer.seed(lines);
+    }
+    bool userExists(const string& phone) const {
+        shared_lock<shared_mutex> lock(accountsMutex);
+        return users.count(phone) > 0;
+    }
+    bool getUser(const string& phone, UserAccount& found) {
+        shared_lock<shared_mutex> lock(accountsMutex);
+        auto it = users.find(phone);
+        if (it == users.end()) return false;
+        lock_guard<mutex> wallet(walletLock(phone));
+        found = it->second;
+        return true;
+    }
+    bool setPaymentMethod(const string& phone, const string& method) {
+        shared_lock<shared_mutex> lock(accountsMutex);
+        auto it = users.find(phone);
+        if (it == users.end()) return false;
+        lock_guard<mutex> wallet(walletLock(phone));
+        it->second.updatePaymentMethod(method);
+        writer.upsert(phone, it->second.csvLine());
+        return true;
+    }
+    void createUser(const string& username, const string& phone) {
+        if (userExists(phone)) { cout << "User already exists!\n"; return; }
+        string email, paymentMethod;
+        cout << "Enter email (optional): "; getline(cin, email);
+        while (true) {
+            cout << "Enter payment method (Cash/Wallet): "; getline(cin, paymentMethod);
+            if (normalize(paymentMethod) == "cash" || normalize(paymentMethod) == "wallet") break;
+            cout << "Invalid payment method! Please choose Cash or Wallet.\n";
+        }
+        paymentMethod = normalize(paymentMethod) == "cash" ? "Cash" : "Wallet";
+        addUser(username, phone, email, paymentMethod);
+        cout << "Account created successfully!\n";
+    }
+    bool addUser(const string& username, const string& phone, const string& email, const string& paymentMethod) {
+        {
+            unique_lock<shared_mutex> lock(accountsMutex);
+            if (!users.emplace(phone, UserAccount(username, phone, email, paymentMethod, 0.0f)).second) return false;
+        }
+        saveUser(phone);
+        return true;
+    }
+    bool chargeWallet(const string& phone, float amount) {
+        ScopedTimer timer(Metric::Payment);
+        shared_lock<shared_mutex> lock(accountsMutex);
+        auto it = users.find(phone);
+        if (it == users.end()) return false;
+        lock_guard<mutex> wallet(walletLock(phone));
+        if (!it->second.makePayment(amount)) return false;
+        writer.upsert(phone, it->second.csvLine());
+        return true;
+    }
+    bool creditWallet(const string& phone, float amount) {
+        ScopedTimer timer(Metric::Payment);
+        shared_lock<shared_mutex> lock(accountsMutex);
+        auto it = users.find(phone);
+        if (it == users.end()) return false;
+        lock_guard<mutex> wallet(walletLock(phone));
+        it->second.addToWallet(amount);
+        writer.upsert(phone, it->second.csvLine());
+        return true;
+    }
+    void saveUser(const string& phone) {
+        shared_lock<shared_mutex> lock(accountsMutex);
+        auto it = users.find(phone);
+        if (it == users.end()) return;
+        lock_guard<mutex> wallet(walletLock(phone));
+        writer.upsert(phone, it->second.csvLine());
+    }
+    vector<string> getPhones() const {
+        shared_lock<shared_mutex> lock(accountsMutex);
+        vector<string> phones;
+        for (const auto& entry : users) phones.push_back(entry.first);
+        return phones;
+    }
+    size_t getUserCount() const {
+        shared_lock<shared_mutex> lock(accountsMutex);
+        return users.size();
+    }
+};
+
+typedef uint32_t NodeId;
+const NodeId INVALID_NODE = numeric_limits<NodeId>::max();
+
+struct SearchWorkspace {
+    vector<float> dist;
+    vector<NodeId> parent;
+    vector<uint32_t> via, reached, settled;
+    uint32_t generation = 0;
+    void reset(size_t n) {
+        if (reached.size() != n) {
+            dist.assign(n, INF); parent.assign(n, INVALID_NODE); via.assign(n, 0);
+            reached.assign(n, 0); settled.assign(n, 0);
+            generation = 0;
+        }
+        if (++generation == 0) {
+            fill(reached.begin(), reached.end(), 0);
+            fill(settled.begin(), settled.end(), 0);
+            generation = 1;
+        }
+    }
+    float distance(NodeId v) const { return reached[v] == generation ? dist[v] : INF; }
+    void reach(NodeId v, float d, NodeId p) { reached[v] = generation; dist[v] = d; parent[v] = p; }
+    void reach(NodeId v, float d, NodeId p, uint32_t arc) { reach(v, d, p); via[v] = arc; }
+    bool isSettled(NodeId v) const { return settled[v] == generation; }
+    void settle(NodeId v) { settled[v] = generation; }
+};
+
+struct ShortestPathTree {
+    vector<pair<float, NodeId>> order;
+    vector<float> dist;
+    vector<NodeId> parent;
+    size_t bytes() const {
+        return sizeof(*this) + order.capacity() * sizeof(order[0]) + dist.capacity() * sizeof(float)
+             + parent.capacity() * sizeof(NodeId);
+    }
+};
+
+class PathCache {
+public:
+    struct Stats { size_t pairHits = 0, treeHits = 0, misses = 0, evictions = 0, invalidations = 0; };
+private:
+    typedef pair<float, vector<NodeId>> PathResult;
+    struct Entry {
+        PathResult result;
+        shared_ptr<const ShortestPathTree> tree;
+        size_t bytes;
+        list<uint64_t>::iterator lru;
+    };
+    static const uint64_t TREE_KEY = 1ULL << 63;
+    static const uint32_t TREE_ADMIT_THRESHOLD = 2;
+    size_t budgetBytes, usedBytes = 0;
+    unordered_map<uint64_t, Entry> entries;
+    list<uint64_t> lru;
+    unordered_map<NodeId, uint32_t> sourceRequests;
+    Stats stats;
+    mutable mutex cacheMutex;
+    static uint64_t pairKey(NodeId s, NodeId d) { return (static_cast<uint64_t>(s) << 32) | d; }
+    Entry* find(uint64_t key) {
+        auto it = entries.find(key);
+        if (it == entries.end()) return nullptr;
+        lru.splice(lru.begin(), lru, it->second.lru);
+        return &it->second;
+    }
+    bool makeRoom(size_t bytes) {
+        if (bytes > budgetBytes) return false;
+        while (usedBytes + bytes > budgetBytes && !lru.empty()) {
+            auto it = entries.find(lru.back());
+            usedBytes -= it->second.bytes;
+            entries.erase(it);
+            lru.pop_back();
+            stats.evictions++;
+        }
+        return true;
+    }
+    void insert(uint64_t key, Entry entry) {
+        auto existing = entries.find(key);
+        if (existing != entries.end()) {
+            usedBytes -= existing->second.bytes;
+            lru.erase(existing->second.lru);
+            entries.erase(existing);
+        }
+        if (!makeRoom(entry.bytes)) return;
+        lru.push_front(key);
+        entry.lru = lru.begin();
+        usedBytes += entry.bytes;
+        entries.emplace(key, move(entry));
+    }
+public:
+    explicit PathCache(size_t budget) : budgetBytes(budget) {}
+    bool findPair(NodeId s, NodeId d, PathResult& result) {
+        lock_guard<mutex> lock(cacheMutex);
+        Entry* entry = find(pairKey(s, d));
+        if (!entry) return false;
+        stats.pairHits++;
+        result = entry->result;
+        return true;
+    }
+    shared_ptr<const ShortestPathTree> findTree(NodeId s) {
+        lock_guard<mutex> lock(cacheMutex);
+        Entry* entry = find(TREE_KEY | s);
+        if (!entry) return nullptr;
+        stats.treeHits++;
+        return entry->tree;
+    }
+    bool admitTree(NodeId s) {
+        lock_guard<mutex> lock(cacheMutex);
+        auto it = sourceRequests.try_emplace(s, 0).first;
+        if (++it->second < TREE_ADMIT_THRESHOLD) return false;
+        // An evicted tree has to earn its way back in, or a working set larger than the budget rebuilds on every miss.
+        sourceRequests.erase(it);
+        return true;
+    }
+    void storePair(NodeId s, NodeId d, const PathResult& result) {
+        size_t bytes = sizeof(Entry) + sizeof(uint64_t) * 4 + result.second.capacity() * sizeof(NodeId);
+        lock_guard<mutex> lock(cacheMutex);
+        insert(pairKey(s, d), {result, nullptr, bytes, {}});
+    }
+    void storeTree(NodeId s, shared_ptr<const ShortestPathTree> tree) {
+        size_t bytes = sizeof(Entry) + sizeof(uint64_t) * 4 + tree->bytes();
+        lock_guard<mutex> lock(cacheMutex);
+        insert(TREE_KEY | s, {{}, move(tree), bytes, {}});
+    }
+    void recordMiss() {
+        lock_guard<mutex> lock(cacheMutex);
+        stats.misses++;
+    }
+    void clear() {
+        lock_guard<mutex> lock(cacheMutex);
+        if (!entries.empty()) stats.invalidations++;
+        entries.clear(); lru.clear(); sourceRequests.clear();
+        usedBytes = 0;
+    }
+    Stats getStats() const {
+        lock_guard<mutex> lock(cacheMutex);
+        return stats;
+    }
+    size_t size() const {
+        lock_guard<mutex> lock(cacheMutex);
+        return entries.size();
+    }
+    size_t memoryUsed() const {
+        lock_guard<mutex> lock(cacheMutex);
+        return usedBytes;
+    }
+};
+
+class ContractionHierarchy {
+private:
+    struct Arc { NodeId to; float weight; NodeId middle; };
+    static const uint32_t FILE_VERSION = 1;
+    static const size_t WITNESS_SETTLE_LIMIT = 500;
+    vector<uint32_t> rank;
+    vector<uint32_t> upOffsets;
+    vector<NodeId> upTargets;
+    vector<float> upWeights;
+    vector<NodeId> upMiddle;
+    uint64_t fingerprint = 0;
+    size_t shortcutCount = 0;
+
+    vector<tuple<NodeId, NodeId, float>> findShortcuts(NodeId v, const vector<vector<Arc>>& adj,
+            const vector<char>& contracted, vector<float>& wdist) const {
+        vector<tuple<NodeId, NodeId, float>> shortcuts;
+        vector<pair<NodeId, float>> neighbors;
+        for (const auto& arc : adj[v]) if (!contracted[arc.to]) neighbors.emplace_back(arc.to, arc.weight);
+        vector<NodeId> touched;
+        for (size_t i = 0; i + 1 < neighbors.size(); i++) {
+            auto [u, wu] = neighbors[i];
+            float limit = 0;
+            for (size_t j = i + 1; j < neighbors.size(); j++) limit = max(limit, wu + neighbors[j].second);
+            for (NodeId t : touched) wdist[t] = INF;
+            touched.clear();
+            wdist[u] = 0; touched.push_back(u);
+            priority_queue<pair<float, NodeId>, vector<pair<float, NodeId>>, greater<>> pq;
+            pq.push({0.0f, u});
+            size_t settled = 0;
+            while (!pq.empty()) {
+                auto [d, x] = pq.top(); pq.pop();
+                if (d > wdist[x]) continue;
+                if (d > limit || ++settled > WITNESS_SETTLE_LIMIT) break;
+                for (const auto& arc : adj[x]) {
+                    if (contracted[arc.to] || arc.to == v) continue;
+                    if (d + arc.weight < wdist[arc.to]) {
+                        if (wdist[arc.to] == INF) touched.push_back(arc.to);
+                        wdist[arc.to] = d + arc.weight;
+                        pq.push({wdist[arc.to], arc.to});
+                    }
+                }
+            }
+            for (size_t j = i + 1; j < neighbors.size(); j++) {
+                auto [x, wx] = neighbors[j];
+                if (wdist[x] > wu + wx) shortcuts.emplace_back(u, x, wu + wx);
+            }
+        }
+        for (NodeId t : touched) wdist[t] = INF;
+        return shortcuts;
+    }
+    NodeId middleOf(NodeId a, NodeId b) const {
+        NodeId low = rank[a] < rank[b] ? a : b, high = low == a ? b : a;
+        for (uint32_t e = upOffsets[low]; e < upOffsets[low + 1]; e++) {
+            if (upTargets[e] == high) return upMiddle[e];
+        }
+        return INVALID_NODE;
+    }
+    void unpackEdge(NodeId a, NodeId b, vector<NodeId>& path) const {
+        NodeId mid = middleOf(a, b);
+        if (mid == INVALID_NODE) { path.push_back(b); return; }
+        unpackEdge(a, mid, path);
+        unpackEdge(mid, b, path);
+    }
+public:
+    bool ready() const { return !rank.empty(); }
+    void clear() { rank.clear(); upOffsets.clear(); upTargets.clear(); upWeights.clear(); upMiddle.clear(); shortcutCount = 0; }
+    size_t getShortcutCount() const { return shortcutCount; }
+    void build(size_t n, ArrayView<uint32_t> offsets, ArrayView<NodeId> targets,
+               ArrayView<float> weights, uint64_t graphFingerprint) {
+        vector<vector<Arc>> adj(n);
+        auto addArc = [&](NodeId a, NodeId b, float w, NodeId mid) {
+            for (auto& arc : adj[a]) {
+                if (arc.to == b) {
+                    if (w < arc.weight) { arc.weight = w; arc.middle = mid; }
+                    return;
+                }
+            }
+            adj[a].push_back({b, w, mid});
+        };
+        for (NodeId u = 0; u < n; u++) {
+            for (uint32_t e = offsets[u]; e < offsets[u + 1]; e++) {
+                if (targets[e] != u) addArc(u, targets[e], weights[e], INVALID_NODE);
+            }
+        }
+        vector<char> contracted(n, 0);
+        vector<int> contractedNeighbors(n, 0);
+        vector<float> wdist(n, INF);
+        auto priority = [&](NodeId v) {
+            int degree = 0;
+            for (const auto& arc : adj[v]) if (!contracted[arc.to]) degree++;
+            int added = static_cast<int>(findShortcuts(v, adj, contracted, wdist).size());
+            return added - degree + contractedNeighbors[v];
+        };
+        priority_queue<pair<int, NodeId>, vector<pair<int, NodeId>>, greater<>> order;
+        for (NodeId v = 0; v < n; v++) order.push({priority(v), v});
+        rank.assign(n, 0);
+        shortcutCount = 0;
+        uint32_t nextRank = 0;
+        while (!order.empty()) {
+            NodeId v = order.top().second; order.pop();
+            int current = priority(v);
+            if (!order.empty() && current > order.top().first) { order.push({current, v}); continue; }
+            for (auto [u, x, w] : findShortcuts(v, adj, contracted, wdist)) {
+                addArc(u, x, w, v);
+                addArc(x, u, w, v);
+                shortcutCount++;
+            }
+            contracted[v] = 1;
+            rank[v] = nextRank++;
+            for (const auto& arc : adj[v]) if (!contracted[arc.to]) contractedNeighbors[arc.to]++;
+        }
+        upOffsets.assign(n + 1, 0);
+        upTargets.clear(); upWeights.clear(); upMiddle.clear();
+        for (NodeId v = 0; v < n; v++) {
+            for (const auto& arc : adj[v]) {
+                if (rank[arc.to] > rank[v]) {
+                    upTargets.push_back(arc.to); upWeights.push_back(arc.weight); upMiddle.push_back(arc.middle);
+                }
+            }
+            upOffsets[v + 1] = static_cast<uint32_t>(upTargets.size());
+        }
+        fingerprint = graphFingerprint;
+    }
+    bool save(const string& path) const {
+        string tempPath = path + ".tmp";
+        ofstream fout(tempPath, ios::binary);
+        if (!fout.is_open()) {
+            cerr << "Error: Could not open " << tempPath << " for writing.\n";
+            return false;
+        }
+        uint64_t header[5] = {FILE_VERSION, fingerprint, rank.size(), upTargets.size(), shortcutCount};
+        fout.write(reinterpret_cast<const char*>(header), sizeof(header));
+        fout.write(reinterpret_cast<const char*>(rank.data()), rank.size() * sizeof(uint32_t));
+        fout.write(reinterpret_cast<const char*>(upOffsets.data()), upOffsets.size() * sizeof(uint32_t));
+        fout.write(reinterpret_cast<const char*>(upTargets.data()), upTargets.size() * sizeof(NodeId));
+        fout.write(reinterpret_cast<const char*>(upWeights.data()), upWeights.size() * sizeof(float));
+        fout.write(reinterpret_cast<const char*>(upMiddle.data()), upMiddle.size() * sizeof(NodeId));
+        fout.close();
+        if (!fout || rename(tempPath.c_str(), path.c_str()) != 0) {
+            remove(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+    // Ranks must be a permutation and every arc must climb, with shortcut middles ranked below both ends, so queries and unpacking terminate.
+    bool valid() const {
+        size_t n = rank.size();
+        vector<char> seen(n, 0);
+        for (uint32_t r : rank) {
+            if (r >= n || seen[r]) return false;
+            seen[r] = 1;
+        }
+        if (upOffsets[0] != 0 || upOffsets[n] != upTargets.size()) return false;
+        for (NodeId u = 0; u < n; u++) {
+            if (upOffsets[u] > upOffsets[u + 1]) return false;
+            for (uint32_t e = upOffsets[u]; e < upOffsets[u + 1]; e++) {
+                NodeId v = upTargets[e], mid = upMiddle[e];
+                if (v >= n || rank[v] <= rank[u] || !(upWeights[e] >= 0.0f)) return false;
+                if (mid != INVALID_NODE && (mid >= n || rank[mid] >= rank[u])) return false;
+            }
+        }
+        return true;
+    }
+    bool load(const string& path, size_t n, uint64_t graphFingerprint) {
+        ifstream fin(path, ios::binary | ios::ate);
+        if (!fin.is_open()) return false;
+        uint64_t fileSize = static_cast<uint64_t>(fin.tellg());
+        fin.seekg(0);
+        uint64_t header[5];
+        if (!fin.read(reinterpret_cast<char*>(header), sizeof(header))) return false;
+        if (header[0] != FILE_VERSION || header[1] != graphFingerprint || header[2] != n) return false;
+        uint64_t arcs = header[3];
+        if (arcs > fileSize || fileSize != sizeof(header) + (2 * n + 1) * sizeof(uint32_t) + arcs * (2 * sizeof(NodeId) + sizeof(float))) return false;
+        rank.resize(n); upOffsets.resize(n + 1);
+        upTargets.resize(arcs); upWeights.resize(arcs); upMiddle.resize(arcs);
+        fin.read(reinterpret_cast<char*>(rank.data()), n * sizeof(uint32_t));
+        fin.read(reinterpret_cast<char*>(upOffsets.data()), (n + 1) * sizeof(uint32_t));
+        fin.read(reinterpret_cast<char*>(upTargets.data()), arcs * sizeof(NodeId));
+        fin.read(reinterpret_cast<char*>(upWeights.data()), arcs * sizeof(float));
+        fin.read(reinterpret_cast<char*>(upMiddle.data()), arcs * sizeof(NodeId));
+        if (!fin || !valid()) { clear(); return false; }
+        fingerprint = graphFingerprint;
+        shortcutCount = header[4];
+        return true;
+    }
+    pair<float, vector<NodeId>> query(NodeId s, NodeId t, SearchWorkspace* spaces) const {
+        if (s == t) return {0.0f, {s}};
+        priority_queue<pair<float, NodeId>, vector<pair<float, NodeId>>, greater<>> pq[2];
+        spaces[0].reset(rank.size()); spaces[1].reset(rank.size());
+        spaces[0].reach(s, 0.0f, INVALID_NODE); pq[0].push({0.0f, s});
+        spaces[1].reach(t, 0.0f, INVALID_NODE); pq[1].push({0.0f, t});
+        float best = INF;
+        NodeId meet = INVALID_NODE;
+        size_t settled = 0, relaxed = 0;
+        while (true) {
+            bool forwardOpen = !pq[0].empty() && pq[0].top().first < best;
+            bool backwardOpen = !pq[1].empty() && pq[1].top().first < best;
+            if (!forwardOpen && !backwardOpen) break;
+            int side = forwardOpen && (!backwardOpen || pq[0].top().first <= pq[1].top().first) ? 0 : 1;
+            auto [d, u] = pq[side].top(); pq[side].pop();
+            if (d > spaces[side].distance(u)) continue;
+            settled++;
+            relaxed += upOffsets[u + 1] - upOffsets[u];
+            if (d + spaces[1 - side].distance(u) < best) {
+                best = d + spaces[1 - side].distance(u);
+                meet = u;
+            }
+            for (uint32_t e = upOffsets[u]; e < upOffsets[u + 1]; e++) {
+                NodeId v = upTargets[e];
+                float nd = d + upWeights[e];
+                if (nd < spaces[side].distance(v)) {
+                    spaces[side].reach(v, nd, u);
+                    pq[side].push({nd, v});
+                }
+            }
+        }
+        Metrics::add(Counter::NodesSettled, settled);
+        Metrics::add(Counter::EdgesRelaxed, relaxed);
+        if (meet == INVALID_NODE) return {INF, {}};
+        vector<NodeId> upChain;
+        for (NodeId at = meet; at != INVALID_NODE; at = spaces[0].parent[at]) upChain.push_back(at);
+        reverse(upChain.begin(), upChain.end());
+        for (NodeId at = spaces[1].parent[meet]; at != INVALID_NODE; at = spaces[1].parent[at]) upChain.push_back(at);
+        vector<NodeId> path = {s};
+        for (size_t i = 0; i + 1 < upChain.size(); i++) unpackEdge(upChain[i], upChain[i + 1], path);
+        return {best, path};
+    }
+};
+
+class TrafficModel {
+private:
+    vector<float> freeSpeed;
+    vector<int32_t> profileSlot;
+    vector<array<float, 24>> profiles;
+    unique_ptr<atomic<float>[]> liveFactor;
+    unique_ptr<atomic<int64_t>[]> liveUntil;
+    size_t edges = 0;
+    atomic<uint64_t> version{0};
+public:
+    array<float, 24> congestion = {1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.95f, 0.85f, 0.7f, 0.55f, 0.5f, 0.65f, 0.75f,
+                                   0.75f, 0.75f, 0.75f, 0.7f, 0.65f, 0.55f, 0.5f, 0.55f, 0.7f, 0.85f, 0.95f, 1.0f};
+    void reset(const vector<float>& lengths) {
+        edges = lengths.size();
+        freeSpeed.resize(edges);
+        for (size_t e = 0; e < edges; e++) freeSpeed[e] = 20.0f + 4.0f * min(lengths[e], 5.0f);
+        profileSlot.assign(edges, -1);
+        profiles.clear();
+        liveFactor.reset(new atomic<float>[edges]);
+        liveUntil.reset(new atomic<int64_t>[edges]);
+        for (size_t e = 0; e < edges; e++) { liveFactor[e] = 1.0f; liveUntil[e] = 0; }
+        version++;
+    }
+    float minutes(uint32_t edge, float km, int hour, int64_t now) const {
+        float speed = freeSpeed[edge] * (profileSlot[edge] < 0 ? congestion[hour] : profiles[profileSlot[edge]][hour]);
+        if (liveUntil[edge].load(memory_order_relaxed) > now) speed *= liveFactor[edge].load(memory_order_relaxed);
+        return km * 60.0f / max(speed, 1.0f);
+    }
+    void setProfile(uint32_t edge, const array<float, 24>& profile) {
+        if (profileSlot[edge] < 0) { profileSlot[edge] = static_cast<int32_t>(profiles.size()); profiles.push_back(profile); }
+        else profiles[profileSlot[edge]] = profile;
+        version++;
+    }
+    float currentFactor(uint32_t edge, int64_t now) const {
+        return liveUntil[edge].load(memory_order_relaxed) > now ? liveFactor[edge].load(memory_order_relaxed) : 1.0f;
+    }
+    void setLive(uint32_t edge, float factor, int64_t until) {
+        liveFactor[edge].store(factor, memory_order_relaxed);
+        liveUntil[edge].store(until, memory_order_relaxed);
+        version++;
+    }
+    size_t liveEdges(int64_t now) const {
+        size_t count = 0;
+        for (size_t e = 0; e < edges; e++) count += liveUntil[e].load(memory_order_relaxed) > now;
+        return count;
+    }
+    size_t profiledEdges() const { return profiles.size(); }
+    uint64_t getVersion() const { return version; }
+};
+
+class EtaCache {
+public:
+    struct Stats { size_t hits = 0, misses = 0, invalidated = 0, flushes = 0; };
+private:
+    struct Entry { float minutes; vector<uint32_t> edges; };
+    static const size_t MAX_ENTRIES = 1 << 18;
+    unordered_map<int64_t, unordered_map<uint64_t, Entry>> byBucket;
+    unordered_map<uint32_t, vector<pair<int64_t, uint64_t>>> byEdge;
+    size_t entryCount = 0, edgeRefs = 0;
+    uint64_t epoch = 0;
+    set<int64_t> liveExpiries;
+    Stats stats;
+    mutable mutex cacheMutex;
+    static uint64_t pairKey(NodeId s, NodeId t) { return (static_cast<uint64_t>(s) << 32) | t; }
+    void clearLocked() {
+        if (entryCount) stats.flushes++;
+        byBucket.clear(); byEdge.clear();
+        entryCount = edgeRefs = 0;
+        epoch++;
+    }
+public:
+    // Searches take the epoch before they start and store under it; invalidation bumps it, so results computed
+    // against older travel times are dropped. A live update running out can only speed routes up, so it flushes.
+    uint64_t beginSearch(int64_t now) {
+        lock_guard<mutex> lock(cacheMutex);
+        if (!liveExpiries.empty() && *liveExpiries.begin() <= now) {
+            liveExpiries.erase(liveExpiries.begin(), liveExpiries.upper_bound(now));
+            clearLocked();
+        }
+        return epoch;
+    }
+    void expireAt(int64_t until) {
+        lock_guard<mutex> lock(cacheMutex);
+        liveExpiries.insert(until);
+    }
+    bool find(int64_t bucket, NodeId s, NodeId t, float& minutes) {
+        lock_guard<mutex> lock(cacheMutex);
+        auto slot = byBucket.find(bucket);
+        if (slot != byBucket.end()) {
+            auto it = slot->second.find(pairKey(s, t));
+            if (it != slot->second.end()) { stats.hits++; minutes = it->second.minutes; return true; }
+        }
+        stats.misses++;
+        return false;
+    }
+    void store(uint64_t searchEpoch, int64_t bucket, NodeId s, NodeId t, float minutes, vector<uint32_t> edges) {
+        lock_guard<mutex> lock(cacheMutex);
+        if (searchEpoch != epoch) return;
+        if (entryCount >= MAX_ENTRIES || edgeRefs >= 8 * MAX_ENTRIES) clearLocked();
+        for (auto it = byBucket.begin(); it != byBucket.end();) {
+            if (it->first < bucket - 1) { entryCount -= it->second.size(); it = byBucket.erase(it); }
+            else ++it;
+        }
+        for (uint32_t edge : edges) byEdge[edge].emplace_back(bucket, pairKey(s, t));
+        edgeRefs += edges.size();
+        if (byBucket[bucket].insert_or_assign(pairKey(s, t), Entry{minutes, move(edges)}).second) entryCount++;
+    }
+    size_t invalidate(const vector<uint32_t>& edges) {
+        if (edges.empty()) return 0;
+        lock_guard<mutex> lock(cacheMutex);
+        size_t removed = 0;
+        for (uint32_t edge : edges) {
+            auto refs = byEdge.find(edge);
+            if (refs == byEdge.end()) continue;
+            for (auto [bucket, key] : refs->second) {
+                auto slot = byBucket.find(bucket);
+                if (slot != byBucket.end() && slot->second.erase(key)) removed++;
+            }
+            edgeRefs -= refs->second.size();
+            byEdge.erase(refs);
+        }
+        entryCount -= removed;
+        stats.invalidated += removed;
+        epoch++;
+        return removed;
+    }
+    void clear() {
+        lock_guard<mutex> lock(cacheMutex);
+        clearLocked();
+    }
+    Stats getStats() const {
+        lock_guard<mutex> lock(cacheMutex);
+        return stats;
+    }
+    size_t size() const {
+        lock_guard<mutex> lock(cacheMutex);
+        return entryCount;
+    }
+};
+
+class LocationIndex {
+private:
+    struct TrieNode { uint32_t firstChild = 0, nextSibling = 0, lo = 0, hi = 0, topOffset = 0, topCount = 0; char label = 0; };
+    vector<TrieNode> trie;
+    vector<NodeId> sorted, tops;
+    vector<string_view> names;
+    vector<uint32_t> weights;
+    unordered_map<uint32_t, vector<NodeId>> gramPostings;
+    static uint32_t gramKey(unsigned char a, unsigned char b, unsigned char c) { return (uint32_t(a) << 16) | (uint32_t(b) << 8) | c; }
+    static vector<uint32_t> grams(string_view word) {
+        string padded = "$$" + string(word) + "$";
+        vector<uint32_t> keys;
+        for (size_t i = 0; i + 2 < padded.size(); i++) keys.push_back(gramKey(padded[i], padded[i + 1], padded[i + 2]));
+        sort(keys.begin(), keys.end());
+        keys.erase(unique(keys.begin(), keys.end()), keys.end());
+        return keys;
+    }
+    bool ranksBefore(NodeId a, NodeId b) const {
+        if (weights[a] != weights[b]) return weights[a] > weights[b];
+        if (names[a].size() != names[b].size()) return names[a].size() < names[b].size();
+        return names[a] < names[b];
+    }
+    static int editDistance(string_view a, string_view b, int limit) {
+        const int far = limit + 1;
+        if (abs(static_cast<int>(a.size()) - static_cast<int>(b.size())) > limit) return far;
+        // Only cells within limit of the diagonal can stay under the limit, so each row fills that band.
+        thread_local vector<int> before, previous, current;
+        before.assign(b.size() + 1, far); previous.assign(b.size() + 1, far); current.assign(b.size() + 1, far);
+        for (size_t j = 0; j <= min(b.size(), size_t(limit)); j++) previous[j] = static_cast<int>(j);
+        for (size_t i = 1; i <= a.size(); i++) {
+            size_t lo = i > size_t(limit) ? i - limit : 1, hi = min(b.size(), i + limit);
+            current[lo - 1] = lo == 1 && i <= size_t(limit) ? static_cast<int>(i) : far;
+            if (hi < b.size()) current[hi + 1] = far;
+            int rowBest = current[lo - 1];
+            for (size_t j = lo; j <= hi; j++) {
+                int cost = a[i - 1] == b[j - 1] ? 0 : 1;
+                current[j] = min({previous[j] + 1, current[j - 1] + 1, previous[j - 1] + cost, far});
+                if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1]) current[j] = min(current[j], before[j - 2] + 1);
+                rowBest = min(rowBest, current[j]);
+            }
+            if (rowBest > limit) return far;
+            swap(before, previous);
+            swap(previous, current);
+        }
+        return previous[b.size()];
+    }
+public:
+    void build(const vector<string_view>& locationNames, const vector<uint32_t>& locationWeights) {
+        names = locationNames;
+        weights = locationWeights;
+        weights.resize(names.size(), 0);
+        sorted.resize(names.size());
+        iota(sorted.begin(), sorted.end(), 0);
+        sort(sorted.begin(), sorted.end(), [this](NodeId a, NodeId b) { return names[a] < names[b]; });
+        trie.assign(1, TrieNode{});
+        trie[0].hi = static_cast<uint32_t>(sorted.size());
+        vector<uint32_t> path(1, 0), lastChild(1, 0);
+        string_view previous;
+        for (uint32_t rank = 0; rank < sorted.size(); rank++) {
+            string_view name = names[sorted[rank]];
+            size_t shared = 0;
+            while (shared < min(name.size(), previous.size()) && shared + 1 < path.size() && name[shared] == previous[shared]) shared++;
+            path.resize(shared + 1);
+            for (size_t depth = shared; depth < name.size(); depth++) {
+                uint32_t parent = path.back(), child = static_cast<uint32_t>(trie.size());
+                TrieNode node;
+                node.label = name[depth];
+                node.lo = rank;
+                trie.push_back(node);
+                lastChild.push_back(0);
+                if (lastChild[parent]) trie[lastChild[parent]].nextSibling = child;
+                else trie[parent].firstChild = child;
+                lastChild[parent] = child;
+                path.push_back(child);
+            }
+            for (uint32_t node : path) trie[node].hi = rank + 1;
+            previous = name;
+        }
+        tops.clear();
+        for (TrieNode& node : trie) {
+            if (node.hi - node.lo <= SUGGESTION_LIMIT) continue;
+            vector<NodeId> range(sorted.begin() + node.lo, sorted.begin() + node.hi);
+            partial_sort(range.begin(), range.begin() + SUGGESTION_LIMIT, range.end(), [this](NodeId a, NodeId b) { return ranksBefore(a, b); });
+            node.topOffset = static_cast<uint32_t>(tops.size());
+            node.topCount = static_cast<uint32_t>(SUGGESTION_LIMIT);
+            tops.insert(tops.end(), range.begin(), range.begin() + SUGGESTION_LIMIT);
+        }
+        gramPostings.clear();
+        for (NodeId id = 0; id < names.size(); id++) {
+            for (uint32_t key : grams(names[id])) gramPostings[key].push_back(id);
+        }
+        for (auto& [key, postings] : gramPostings) {
+            stable_sort(postings.begin(), postings.end(), [this](NodeId a, NodeId b) { return names[a].size() < names[b].size(); });
+        }
+    }
+    vector<NodeId> complete(string_view prefix, size_t limit = SUGGESTION_LIMIT) const {
+        if (trie.empty()) return {};
+        uint32_t at = 0;
+        for (char c : prefix) {
+            uint32_t child = trie[at].firstChild;
+            while (child && trie[child].label != c) child = trie[child].nextSibling;
+            if (!child) return {};
+            at = child;
+        }
+        const TrieNode& node = trie[at];
+        vector<NodeId> result;
+        if (node.topCount) result.assign(tops.begin() + node.topOffset, tops.begin() + node.topOffset + node.topCount);
+        else {
+            result.assign(sorted.begin() + node.lo, sorted.begin() + node.hi);
+            sort(result.begin(), result.end(), [this](NodeId a, NodeId b) { return ranksBefore(a, b); });
+        }
+        if (result.size() > limit) result.resize(limit);
+        return result;
+    }
+    vector<pair<NodeId, int>> fuzzy(string_view query, size_t limit = SUGGESTION_LIMIT) const {
+        vector<pair<NodeId, int>> matches;
+        if (query.empty() || names.empty()) return matches;
+        int maxEdits = query.size() <= 4 ? 1 : query.size() <= 8 ? 2 : 3;
+        size_t shortest = query.size() > size_t(maxEdits) ? query.size() - maxEdits : 0, longest = query.size() + maxEdits;
+        auto byLength = [this](NodeId id, size_t length) { return names[id].size() < length; };
+        vector<pair<const NodeId*, const NodeId*>> lists;
+        for (uint32_t key : grams(query)) {
+            auto postings = gramPostings.find(key);
+            if (postings == gramPostings.end()) { lists.emplace_back(nullptr, nullptr); continue; }
+            const vector<NodeId>& ids = postings->second;
+            auto lo = lower_bound(ids.begin(), ids.end(), shortest, byLength);
+            auto hi = lower_bound(lo, ids.end(), longest + 1, byLength);
+            lists.emplace_back(ids.data() + (lo - ids.begin()), ids.data() + (hi - ids.begin()));
+        }
+        sort(lists.begin(), lists.end(), [](const auto& a, const auto& b) { return a.second - a.first < b.second - b.first; });
+        thread_local vector<uint16_t> shared;
+        thread_local vector<NodeId> touched;
+        if (shared.size() < names.size()) shared.resize(names.size(), 0);
+        // Each edit destroys at most three trigrams, so a name within k edits shares all but 3k of the
+        // query's trigrams and must appear in one of the 3k + 1 rarest lists.
+        size_t seeds = min(lists.size(), size_t(3 * maxEdits + 1));
+        touched.clear();
+        for (size_t i = 0; i < lists.size(); i++) {
+            for (const NodeId* it = lists[i].first; it != lists[i].second; ++it) {
+                if (shared[*it] == 0) {
+                    if (i >= seeds) continue;
+                    touched.push_back(*it);
+                }
+                shared[*it]++;
+            }
+        }
+        // Closer matches always rank first, so widen k only while there are too few of them.
+        for (int edits = 1; edits <= maxEdits && matches.size() < limit; edits++) {
+            matches.clear();
+            int needed = static_cast<int>(lists.size()) - 3 * edits;
+            for (NodeId id : touched) {
+                if (shared[id] < needed || abs(static_cast<int>(names[id].size()) - static_cast<int>(query.size())) > edits) continue;
+                int distance = editDistance(query, names[id], edits);
+                if (distance <= edits) matches.emplace_back(id, distance);
+            }
+        }
+        for (NodeId id : touched) shared[id] = 0;
+        sort(matches.begin(), matches.end(), [this](const pair<NodeId, int>& a, const pair<NodeId, int>& b) {
+            return a.second != b.second ? a.second < b.second : ranksBefore(a.first, b.first);
+        });
+        if (matches.size() > limit) matches.resize(limit);
+        return matches;
+    }
+    vector<NodeId> suggest(string_view typed, size_t limit = SUGGESTION_LIMIT) const {
+        vector<NodeId> result = complete(typed, limit);
+        if (result.empty()) {
+            for (auto [id, distance] : fuzzy(typed, limit)) result.push_back(id);
+        }
+        return result;
+    }
+};
+
+enum class SearchMode { Dijkstra, Bidirectional, AStar, Hierarchy };
+
+string searchModeName(SearchMode mode) {
+    switch (mode) {
+        case SearchMode::Dijkstra: return "Dijkstra";
+        case SearchMode::Bidirectional: return "Bidirectional Dijkstra";
+        case SearchMode::AStar: return "A* (haversine)";
+        case SearchMode::Hierarchy: return "Contraction Hierarchy";
+    }
+    return "Unknown";
+}
+
+class Graph {
+private:
+    struct EdgeRecord { NodeId from, to; float distance; };
+    struct SnapshotHeader {
+        char magic[8];
+        uint64_t version, sourceSize;
+        int64_t sourceMtime;
+        uint64_t nodeCount, edgeCount, arcCount, nameBytes, fingerprint;
+    };
+    static const uint64_t SNAPSHOT_VERSION = 1;
+    deque<string> ownedNames;
+    unordered_map<string_view, NodeId> nodeIds;
+    vector<string_view> nodeNames;
+    vector<EdgeRecord> ownedEdges;
+    vector<uint32_t> ownedOffsets;
+    vector<NodeId> ownedTargets;
+    vector<float> ownedWeights;
+    ArrayView<EdgeRecord> edges;
+    ArrayView<uint32_t> edgeOffsets;
+    ArrayView<NodeId> edgeTargets;
+    ArrayView<float> edgeWeights;
+    shared_ptr<MappedFile> snapshot;
+    uint64_t cachedFingerprint = 0;
+    vector<float> latRad, lonRad, cosLat;
+    vector<char> hasCoords;
+    float heuristicScale = 0.0f;
+    ContractionHierarchy hierarchy;
+    SearchMode searchMode = SearchMode::Hierarchy;
+    mutable PathCache pathCache{PATH_CACHE_BYTES};
+    vector<uint32_t> arcEdge;
+    unordered_map<uint64_t, uint32_t> edgeByPair;
+    TrafficModel traffic;
+    mutable EtaCache etaCache;
+    mutex trafficMutex;
+    LocationIndex locationIndex;
+    static uint64_t nodePairKey(NodeId a, NodeId b) { return (static_cast<uint64_t>(min(a, b)) << 32) | max(a, b); }
+    void indexArcs() {
+        size_t n = nodeNames.size();
+        arcEdge.assign(edgeOffsets.size() ? edgeOffsets[n] : 0, 0);
+        edgeByPair.clear();
+        vector<uint32_t> cursor(edgeOffsets.begin(), edgeOffsets.begin() + n);
+        vector<float> lengths(edges.size());
+        for (uint32_t e = 0; e < edges.size(); e++) {
+            arcEdge[cursor[edges[e].from]++] = e;
+            arcEdge[cursor[edges[e].to]++] = e;
+            lengths[e] = edges[e].distance;
+            auto [it, added] = edgeByPair.emplace(nodePairKey(edges[e].from, edges[e].to), e);
+            if (!added && edges[e].distance < edges[it->second].distance) it->second = e;
+        }
+        traffic.reset(lengths);
+        etaCache.clear();
+        vector<uint32_t> degree(n);
+        for (NodeId v = 0; v < n; v++) degree[v] = edgeOffsets[v + 1] - edgeOffsets[v];
+        locationIndex.build(nodeNames, degree);
+    }
+    static void clockOf(time_t when, int& hour, int& secondOfHour) {
+        tm local{};
+#ifdef _WIN32
+        localtime_s(&local, &when);
+#else
+        localtime_r(&when, &local);
+#endif
+        hour = local.tm_hour;
+        secondOfHour = local.tm_min * 60 + local.tm_sec;
+    }
+    static SearchWorkspace* searchSpaces() {
+        thread_local SearchWorkspace spaces[2];
+        return spaces;
+    }
+    NodeId internLocation(const string& key) {
+        auto it = nodeIds.find(key);
+        if (it != nodeIds.end()) return it->second;
+        ownedNames.push_back(key);
+        heuristicScale = 0.0f;
+        NodeId id = static_cast<NodeId>(nodeNames.size());
+        nodeNames.push_back(ownedNames.back());
+        nodeIds.emplace(nodeNames.back(), id);
+        return id;
+    }
+    static void writeSection(ofstream& fout, const void* data, size_t bytes) {
+        static const char padding[8] = {};
+        fout.write(static_cast<const char*>(data), bytes);
+        if (bytes % 8) fout.write(padding, 8 - bytes % 8);
+    }
+    template <typename T>
+    static bool readSection(const MappedFile& file, size_t& offset, uint64_t count, ArrayView<T>& view) {
+        if (offset > file.size() || count > (file.size() - offset) / sizeof(T)) return false;
+        size_t bytes = count * sizeof(T);
+        view = ArrayView<T>(reinterpret_cast<const T*>(file.data() + offset), count);
+        offset += (bytes + 7) / 8 * 8;
+        return true;
+    }
+    // A truncated or corrupted snapshot must be rejected here: everything after this indexes the mapped arrays unchecked.
+    static bool validSnapshot(const SnapshotHeader& header, ArrayView<EdgeRecord> mappedEdges, ArrayView<uint32_t> mappedOffsets,
+                              ArrayView<NodeId> mappedTargets, ArrayView<float> mappedWeights, ArrayView<uint32_t> nameOffsets) {
+        uint64_t n = header.nodeCount;
+        if (header.arcCount != 2 * header.edgeCount) return false;
+        if (mappedOffsets[0] != 0 || mappedOffsets[n] != header.arcCount || nameOffsets[0] != 0 || nameOffsets[n] != header.nameBytes) return false;
+        vector<uint32_t> degree(n, 0);
+        for (const auto& e : mappedEdges) {
+            if (e.from >= n || e.to >= n || !(e.distance >= 0.0f)) return false;
+            degree[e.from]++; degree[e.to]++;
+        }
+        for (size_t v = 0; v < n; v++) {
+            if (mappedOffsets[v] > mappedOffsets[v + 1] || mappedOffsets[v + 1] - mappedOffsets[v] != degree[v]) return false;
+            if (nameOffsets[v] > nameOffsets[v + 1]) return false;
+        }
+        for (size_t a = 0; a < header.arcCount; a++) {
+            if (mappedTargets[a] >= n || !(mappedWeights[a] >= 0.0f)) return false;
+        }
+        return true;
+    }
+    void stageEdge(string_view from, string_view to, float distance) {
+        NodeId a = internLocation(normalize(from)), b = internLocation(normalize(to));
+        if (edges.ptr != ownedEdges.data()) ownedEdges.assign(edges.begin(), edges.end());
+        ownedEdges.push_back({a, b, distance});
+        edges = ArrayView<EdgeRecord>(ownedEdges);
+        cachedFingerprint = 0;
+    }
+public:
+    // The CSR is rebuilt by every mutation, so queries never rebuild it and can run on many threads at once.
+    void addEdge(string_view from, string_view to, float distance) {
+        stageEdge(from, to, distance);
+        buildAdjacency();
+    }
+    void buildAdjacency() {
+        size_t n = nodeNames.size();
+        ownedOffsets.assign(n + 1, 0);
+        for (const auto& e : edges) { ownedOffsets[e.from + 1]++; ownedOffsets[e.to + 1]++; }
+        for (size_t i = 0; i < n; i++) ownedOffsets[i + 1] += ownedOffsets[i];
+        ownedTargets.assign(ownedOffsets[n], INVALID_NODE);
+        ownedWeights.assign(ownedOffsets[n], INF);
+        vector<uint32_t> cursor(ownedOffsets.begin(), ownedOffsets.end() - 1);
+        for (const auto& e : edges) {
+            ownedTargets[cursor[e.from]] = e.to; ownedWeights[cursor[e.from]++] = e.distance;
+            ownedTargets[cursor[e.to]] = e.from; ownedWeights[cursor[e.to]++] = e.distance;
+        }
+        edgeOffsets = ArrayView<uint32_t>(ownedOffsets);
+        edgeTargets = ArrayView<NodeId>(ownedTargets);
+        edgeWeights = ArrayView<float>(ownedWeights);
+        hierarchy.clear();
+        pathCache.clear();
+        indexArcs();
+    }
+    bool saveSnapshot(const string& path, uint64_t sourceSize, int64_t sourceMtime) {
+        vector<uint32_t> nameOffsets(1, 0);
+        string nameChars;
+        for (string_view name : nodeNames) {
+            nameChars.append(name.data(), name.size());
+            nameOffsets.push_back(static_cast<uint32_t>(nameChars.size()));
+        }
+        SnapshotHeader header = {{'R', 'B', 'G', 'R', 'A', 'P', 'H', 0}, SNAPSHOT_VERSION, sourceSize, sourceMtime,
+                                 nodeNames.size(), edges.size(), edgeTargets.size(), nameChars.size(), fingerprint()};
+        string tempPath = path + ".tmp";
+        ofstream fout(tempPath, ios::binary);
+        if (!fout.is_open()) {
+            cerr << "Error: Could not open " << tempPath << " for writing.\n";
+            return false;
+        }
+        writeSection(fout, &header, sizeof(header));
+        writeSection(fout, edges.begin(), edges.size() * sizeof(EdgeRecord));
+        writeSection(fout, edgeOffsets.begin(), edgeOffsets.size() * sizeof(uint32_t));
+        writeSection(fout, edgeTargets.begin(), edgeTargets.size() * sizeof(NodeId));
+        writeSection(fout, edgeWeights.begin(), edgeWeights.size() * sizeof(float));
+        writeSection(fout, nameOffsets.data(), nameOffsets.size() * sizeof(uint32_t));
+        writeSection(fout, nameChars.data(), nameChars.size());
+        fout.close();
+        if (!fout || rename(tempPath.c_str(), path.c_str()) != 0) {
+            remove(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+    bool loadSnapshot(const string& path, uint64_t sourceSize, int64_t sourceMtime) {
+        auto file = make_shared<MappedFile>();
+        if (!file->open(path) || file->size() < sizeof(SnapshotHeader)) return false;
+        SnapshotHeader header;
+        memcpy(&header, file->data(), sizeof(header));
+        if (memcmp(header.magic, "RBGRAPH", 8) != 0 || header.version != SNAPSHOT_VERSION ||
+            header.sourceSize != sourceSize || header.sourceMtime != sourceMtime || header.nodeCount >= INVALID_NODE) return false;
+        size_t offset = sizeof(SnapshotHeader);
+        ArrayView<uint32_t> nameOffsets;
+        ArrayView<char> nameChars;
+        ArrayView<EdgeRecord> mappedEdges;
+        ArrayView<uint32_t> mappedOffsets;
+        ArrayView<NodeId> mappedTargets;
+        ArrayView<float> mappedWeights;
+        if (!readSection(*file, offset, header.edgeCount, mappedEdges) ||
+            !readSection(*file, offset, header.nodeCount + 1, mappedOffsets) ||
+            !readSection(*file, offset, header.arcCount, mappedTargets) ||
+            !readSection(*file, offset, header.arcCount, mappedWeights) ||
+            !readSection(*file, offset, header.nodeCount + 1, nameOffsets) ||
+            !readSection(*file, offset, header.nameBytes, nameChars) ||
+            !validSnapshot(header, mappedEdges, mappedOffsets, mappedTargets, mappedWeights, nameOffsets)) return false;
+        ownedNames.clear(); ownedEdges.clear(); ownedOffsets.clear(); ownedTargets.clear(); ownedWeights.clear();
+        nodeNames.clear(); nodeIds.clear();
+        nodeNames.reserve(header.nodeCount);
+        nodeIds.reserve(header.nodeCount);
+        for (size_t i = 0; i < header.nodeCount; i++) {
+            nodeNames.emplace_back(nameChars.begin() + nameOffsets[i], nameOffsets[i + 1] - nameOffsets[i]);
+            if (!nodeIds.emplace(nodeNames.back(), static_cast<NodeId>(i)).second) {
+                nodeNames.clear(); nodeIds.clear();
+                return false;
+            }
+        }
+        edges = mappedEdges; edgeOffsets = mappedOffsets; edgeTargets = mappedTargets; edgeWeights = mappedWeights;
+        snapshot = file;
+        cachedFingerprint = header.fingerprint;
+        hierarchy.clear();
+        pathCache.clear();
+        indexArcs();
+        return true;
+    }
+    size_t edgeCount() const { return edges.size(); }
+    uint64_t fingerprint() {
+        if (cachedFingerprint) return cachedFingerprint;
+        uint64_t hash = 14695981039346656037ULL;
+        auto mix = [&](uint32_t value) { for (int i = 0; i < 4; i++) { hash ^= (value >> (8 * i)) & 0xff; hash *= 1099511628211ULL; } };
+        mix(static_cast<uint32_t>(nodeNames.size()));
+        for (const auto& e : edges) {
+            uint32_t bits; memcpy(&bits, &e.distance, sizeof(bits));
+            mix(e.from); mix(e.to); mix(bits);
+        }
+        cachedFingerprint = hash;
+        return hash;
+    }
+    void prepareHierarchy(const string& path) {
+        uint64_t fp = fingerprint();
+        if (hierarchy.load(path, nodeNames.size(), fp)) {
+            cout << "Loaded contraction hierarchy from " << path << " (" << hierarchy.getShortcutCount() << " shortcuts).\n";
+            return;
+        }
+        hierarchy.build(nodeNames.size(), edgeOffsets, edgeTargets, edgeWeights, fp);
+        hierarchy.save(path);
+        cout << "Built contraction hierarchy (" << hierarchy.getShortcutCount() << " shortcuts).\n";
+    }
+    float getHeuristicScale() const { return heuristicScale; }
+    void setSearchMode(SearchMode mode) {
+        if (mode != searchMode) pathCache.clear();
+        searchMode = mode;
+    }
+    const PathCache& getPathCache() const { return pathCache; }
+    SearchMode getSearchMode() const { return searchMode; }
+    size_t nodeCount() const { return nodeNames.size(); }
+    NodeId findLocation(string_view location) const {
+        string key = normalize(location);
+        auto it = nodeIds.find(key);
+        return it == nodeIds.end() ? INVALID_NODE : it->second;
+    }
+    string_view locationName(NodeId id) const { return nodeNames[id]; }
+    bool addLocation(string_view location, float lat, float lon) {
+        NodeId id = findLocation(location);
+        if (id == INVALID_NODE) return false;
+        if (hasCoords.size() < nodeNames.size()) {
+            latRad.resize(nodeNames.size()); lonRad.resize(nodeNames.size());
+            cosLat.resize(nodeNames.size()); hasCoords.resize(nodeNames.size(), 0);
+        }
+        latRad[id] = lat * PI / 180.0; lonRad[id] = lon * PI / 180.0;
+        cosLat[id] = cos(latRad[id]);
+        hasCoords[id] = 1;
+        return true;
+    }
+    bool hasLocationCoords(NodeId id) const { return id < hasCoords.size() && hasCoords[id]; }
+    float haversineDistance(NodeId a, NodeId b) const {
+        if (!hasLocationCoords(a) || !hasLocationCoords(b)) return INF;
+        return haversineKm(latRad[b] - latRad[a], lonRad[b] - lonRad[a], cosLat[a], cosLat[b]);
+    }
+    float haversineDistance(const string& loc1, const string& loc2) const {
+        return haversineDistance(findLocation(loc1), findLocation(loc2));
+    }
+    // The straight-line bound needs coordinates for every location, otherwise a route through one without them
+    // could be shorter than the bound; A* and the driver grid prefilter then fall back to plain search.
+    void calibrateHeuristic() {
+        heuristicScale = 0.0f;
+        for (NodeId id = 0; id < nodeCount(); id++) if (!hasLocationCoords(id)) return;
+        heuristicScale = 1.0f;
+        for (const auto& e : edges) {
+            float straight = haversineDistance(e.from, e.to);
+            if (straight != INF && straight > 0) heuristicScale = min(heuristicScale, e.distance / straight);
+        }
+        heuristicScale = max(0.0f, heuristicScale);
+    }
+    bool coordinates(NodeId id, float& lat, float& lon) const {
+        if (!hasLocationCoords(id)) return false;
+        lat = latRad[id] * 180.0 / PI; lon = lonRad[id] * 180.0 / PI;
+        return true;
+    }
+    float distanceLowerBound(NodeId a, NodeId b) const {
+        float straight = haversineDistance(a, b);
+        return straight == INF ? 0.0f : heuristicScale * straight;
+    }
+    pair<float, vector<NodeId>> shortestPath(NodeId s, NodeId d) const {
+        ScopedTimer timer(Metric::ShortestPath);
+        if (s == INVALID_NODE || d == INVALID_NODE) return {INF, {}};
+        pair<float, vector<NodeId>> cached;
+        if (pathCache.findPair(s, d, cached)) return cached;
+        if (auto tree = pathCache.findTree(s)) return pathFromTree(*tree, d, true);
+        if (auto tree = pathCache.findTree(d)) return pathFromTree(*tree, s, false);
+        pathCache.recordMiss();
+        auto result = computePath(s, d);
+        pathCache.storePair(s, d, result);
+        return result;
+    }
+    pair<float, vector<NodeId>> pathFromTree(const ShortestPathTree& tree, NodeId from, bool reversed) const {
+        if (tree.dist[from] == INF) return {INF, {}};
+        vector<NodeId> path;
+        for (NodeId at = from; at != INVALID_NODE; at = tree.parent[at]) path.push_back(at);
+        if (reversed) reverse(path.begin(), path.end());
+        return {tree.dist[from], path};
+    }
+    shared_ptr<const ShortestPathTree> buildTree(NodeId s) const {
+        auto tree = make_shared<ShortestPathTree>();
+        size_t n = nodeNames.size();
+        tree->dist.assign(n, INF);
+        tree->parent.assign(n, INVALID_NODE);
+        vector<char> visited(n, 0);
+        tree->dist[s] = 0.0f;
+        priority_queue<pair<float, NodeId>, vector<pair<float, NodeId>>, greater<>> pq;
+        pq.push({0.0f, s});
+        while (!pq.empty()) {
+            auto [currDist, u] = pq.top(); pq.pop();
+            if (visited[u]) continue;
+            visited[u] = 1;
+            tree->order.emplace_back(currDist, u);
+            for (uint32_t e = edgeOffsets[u]; e < edgeOffsets[u + 1]; e++) {
+                NodeId v = edgeTargets[e];
+                if (currDist + edgeWeights[e] < tree->dist[v]) {
+                    tree->dist[v] = currDist + edgeWeights[e];
+                    tree->parent[v] = u;
+                    pq.push({tree->dist[v], v});
+                }
+            }
+        }
+        return tree;
+    }
+    pair<float, vector<NodeId>> computePath(NodeId s, NodeId d) const {
+        if (searchMode == SearchMode::Hierarchy && hierarchy.ready()) return hierarchy.query(s, d, searchSpaces());
+        if (searchMode == SearchMode::Bidirectional) return bidirectionalPath(s, d);
+        if (searchMode == SearchMode::AStar) return aStarPath(s, d);
+        size_t n = nodeNames.size();
+        vector<float> dist(n, INF);
+        vector<NodeId> parent(n, INVALID_NODE);
+        vector<char> visited(n, 0);
+        dist[s] = 0.0;
+        size_t settled = 0, relaxed = 0;
+        priority_queue<pair<float, NodeId>, vector<pair<float, NodeId>>, greater<>> pq;
+        pq.push({0.0, s});
+        while (!pq.empty()) {
+            auto [currDist, u] = pq.top(); pq.pop();
+            if (visited[u]) continue;
+            visited[u] = 1;
+            settled++;
+            relaxed += edgeOffsets[u + 1] - edgeOffsets[u];
+            for (uint32_t e = edgeOffsets[u]; e < edgeOffsets[u + 1]; e++) {
+                NodeId v = edgeTargets[e];
+                if (dist[v] > dist[u] + edgeWeights[e]) {
+                    dist[v] = dist[u] + edgeWeights[e];
+                    parent[v] = u;
+                    pq.push({dist[v], v});
+                }
+            }
+        }
+        Metrics::add(Counter::NodesSettled, settled);
+        Metrics::add(Counter::EdgesRelaxed, relaxed);
+        if (dist[d] == INF) return {INF, {}};
+        vector<NodeId> path;
+        for (NodeId at = d; at != s; at = parent[at]) path.push_back(at);
+        path.push_back(s);
+        reverse(path.begin(), path.end());
+        return {dist[d], path};
+    }
+    template <typename Visit>
+    void searchFrom(NodeId s, float maxDist, Visit&& visit) const {
+        if (s == INVALID_NODE) return;
+        if (auto tree = pathCache.findTree(s)) {
+            for (auto [d, u] : tree->order) if (d > maxDist || !visit(u, d)) return;
+            return;
+        }
+        pathCache.recordMiss();
+        SearchWorkspace& space = searchSpaces()[0];
+        space.reset(nodeNames.size());
+        priority_queue<pair<float, NodeId>, vector<pair<float, NodeId>>, greater<>> pq;
+        space.reach(s, 0.0f, INVALID_NODE);
+        pq.push({0.0f, s});
+        size_t settled = 0;
+        while (!pq.empty()) {
+            auto [currDist, u] = pq.top(); pq.pop();
+            if (currDist > maxDist) break;
+            if (space.isSettled(u)) continue;
+            space.settle(u);
+            settled++;
+            if (!visit(u, currDist)) break;
+            for (uint32_t e = edgeOffsets[u]; e < edgeOffsets[u + 1]; e++) {
+                NodeId v = edgeTargets[e];
+                if (currDist + edgeWeights[e] < space.distance(v)) {
+                    space.reach(v, currDist + edgeWeights[e], u);
+                    pq.push({currDist + edgeWeights[e], v});
+                }
+            }
+        }
+        // A full tree only pays off for sources whose searches sweep a large part of the city (scarce supply nearby).
+        if (settled * 4 >= nodeNames.size() && pathCache.admitTree(s)) pathCache.storeTree(s, buildTree(s));
+    }
+    vector<float> distancesToTargets(NodeId s, const vector<NodeId>& targets, size_t k, float maxDist = INF) const {
+        vector<float> result(targets.size(), INF);
+        if (s == INVALID_NODE || k == 0) return result;
+        unordered_map<NodeId, vector<size_t>> targetSlots;
+        for (size_t i = 0; i < targets.size(); i++) if (targets[i] != INVALID_NODE) targetSlots[targets[i]].push_back(i);
+        size_t remaining = targetSlots.size(), settled = 0;
+        if (remaining == 0) return result;
+        searchFrom(s, maxDist, [&](NodeId u, float d) {
+            auto it = targetSlots.find(u);
+            if (it == targetSlots.end()) return true;
+            for (size_t slot : it->second) result[slot] = d;
+            settled += it->second.size();
+            return --remaining > 0 && settled < k;
+        });
+        return result;
+    }
+    pair<float, vector<NodeId>> aStarPath(NodeId s, NodeId d) const {
+        SearchWorkspace& space = searchSpaces()[0];
+        space.reset(nodeNames.size());
+        priority_queue<tuple<float, float, NodeId>, vector<tuple<float, float, NodeId>>, greater<>> pq;
+        space.reach(s, 0.0f, INVALID_NODE);
+        pq.push({distanceLowerBound(s, d), 0.0f, s});
+        size_t settled = 0, relaxed = 0;
+        while (!pq.empty()) {
+            auto [estimate, currDist, u] = pq.top(); pq.pop();
+            if (currDist > space.distance(u)) continue;
+            settled++;
+            if (u == d) break;
+            relaxed += edgeOffsets[u + 1] - edgeOffsets[u];
+            for (uint32_t e = edgeOffsets[u]; e < edgeOffsets[u + 1]; e++) {
+                NodeId v = edgeTargets[e];
+                float nd = currDist + edgeWeights[e];
+                if (nd < space.distance(v)) {
+                    space.reach(v, nd, u);
+                    pq.push({nd + distanceLowerBound(v, d), nd, v});
+                }
+            }
+        }
+        Metrics::add(Counter::NodesSettled, settled);
+        Metrics::add(Counter::EdgesRelaxed, relaxed);
+        if (space.distance(d) == INF) return {INF, {}};
+        vector<NodeId> path;
+        for (NodeId at = d; at != INVALID_NODE; at = space.parent[at]) path.push_back(at);
+        reverse(path.begin(), path.end());
+        return {space.distance(d), path};
+    }
+    pair<float, vector<NodeId>> bidirectionalPath(NodeId s, NodeId d) const {
+        size_t n = nodeNames.size();
+        SearchWorkspace* spaces = searchSpaces();
+        spaces[0].reset(n);
+        spaces[1].reset(n);
+        priority_queue<pair<float, NodeId>, vector<pair<float, NodeId>>, greater<>> pq[2];
+        spaces[0].reach(s, 0.0f, INVALID_NODE); pq[0].push({0.0f, s});
+        spaces[1].reach(d, 0.0f, INVALID_NODE); pq[1].push({0.0f, d});
+        float best = s == d ? 0.0f : INF;
+        NodeId meet = s == d ? s : INVALID_NODE;
+        size_t settled = 0, relaxed = 0;
+        while (!pq[0].empty() && !pq[1].empty() && pq[0].top().first + pq[1].top().first < best) {
+            int side = pq[0].size() <= pq[1].size() ? 0 : 1;
+            SearchWorkspace& space = spaces[side];
+            const SearchWorkspace& other = spaces[1 - side];
+            auto [currDist, u] = pq[side].top(); pq[side].pop();
+            if (space.isSettled(u)) continue;
+            space.settle(u);
+            settled++;
+            relaxed += edgeOffsets[u + 1] - edgeOffsets[u];
+            for (uint32_t e = edgeOffsets[u]; e < edgeOffsets[u + 1]; e++) {
+                NodeId v = edgeTargets[e];
+                float nd = currDist + edgeWeights[e];
+                if (nd < space.distance(v)) {
+                    space.reach(v, nd, u);
+                    pq[side].push({nd, v});
+                }
+                if (nd + other.distance(v) < best) {
+                    best = nd + other.distance(v);
+                    meet = v;
+                }
+            }
+        }
+        Metrics::add(Counter::NodesSettled, settled);
+        Metrics::add(Counter::EdgesRelaxed, relaxed);
+        if (meet == INVALID_NODE) return {INF, {}};
+        vector<NodeId> path;
+        for (NodeId at = meet; at != INVALID_NODE; at = spaces[0].parent[at]) path.push_back(at);
+        reverse(path.begin(), path.end());
+        for (NodeId at = spaces[1].parent[meet]; at != INVALID_NODE; at = spaces[1].parent[at]) path.push_back(at);
+        return {best, path};
+    }
+    bool locationExists(const string& location) const { return findLocation(location) != INVALID_NODE; }
+    vector<NodeId> suggestLocations(const string& typed, size_t limit = SUGGESTION_LIMIT) const {
+        return locationIndex.suggest(normalize(typed), limit);
+    }
+    vector<float> travelMinutesTo(NodeId s, const vector<NodeId>& targets, time_t departure, float maxMinutes = INF) const {
+        vector<float> result(targets.size(), INF);
+        if (s == INVALID_NODE || targets.empty()) return result;
+        int64_t bucket = static_cast<int64_t>(departure) / 900;
+        uint64_t epoch = etaCache.beginSearch(static_cast<int64_t>(departure));
+        unordered_map<NodeId, vector<size_t>> pending;
+        for (size_t i = 0; i < targets.size(); i++) {
+            if (targets[i] == INVALID_NODE) continue;
+            if (!etaCache.find(bucket, s, targets[i], result[i])) pending[targets[i]].push_back(i);
+        }
+        if (pending.empty()) return result;
+        int startHour, startSecond;
+        clockOf(static_cast<time_t>(bucket * 900), startHour, startSecond);
+        int64_t now = static_cast<int64_t>(departure);
+        SearchWorkspace& space = searchSpaces()[0];
+        space.reset(nodeNames.size());
+        priority_queue<pair<float, NodeId>, vector<pair<float, NodeId>>, greater<>> pq;
+        space.reach(s, 0.0f, INVALID_NODE);
+        pq.push({0.0f, s});
+        size_t remaining = pending.size();
+        while (!pq.empty() && remaining > 0) {
+            auto [elapsed, u] = pq.top(); pq.pop();
+            if (elapsed > maxMinutes) break;
+            if (space.isSettled(u)) continue;
+            space.settle(u);
+            auto hit = pending.find(u);
+            if (hit != pending.end()) {
+                vector<uint32_t> used;
+                for (NodeId at = u; at != s; at = space.parent[at]) used.push_back(arcEdge[space.via[at]]);
+                for (size_t slot : hit->second) result[slot] = elapsed;
+                etaCache.store(epoch, bucket, s, u, elapsed, move(used));
+                remaining--;
+            }
+            int hour = (startHour + (startSecond + static_cast<int>(elapsed * 60)) / 3600) % 24;
+            for (uint32_t e = edgeOffsets[u]; e < edgeOffsets[u + 1]; e++) {
+                NodeId v = edgeTargets[e];
+                float nd = elapsed + traffic.minutes(arcEdge[e], edgeWeights[e], hour, now);
+                if (nd < space.distance(v)) {
+                    space.reach(v, nd, u, e);
+                    pq.push({nd, v});
+                }
+            }
+        }
+        return result;
+    }
+    float routeMinutes(const vector<NodeId>& path, time_t departure) const {
+        if (path.size() < 2) return 0.0f;
+        int startHour, startSecond;
+        clockOf(departure, startHour, startSecond);
+        float elapsed = 0.0f;
+        for (size_t i = 0; i + 1 < path.size(); i++) {
+            int hour = (startHour + (startSecond + static_cast<int>(elapsed * 60)) / 3600) % 24;
+            float best = INF;
+            for (uint32_t e = edgeOffsets[path[i]]; e < edgeOffsets[path[i] + 1]; e++) {
+                if (edgeTargets[e] == path[i + 1]) best = min(best, traffic.minutes(arcEdge[e], edgeWeights[e], hour, departure));
+            }
+            if (best == INF) return INF;
+            elapsed += best;
+        }
+        return elapsed;
+    }
+    size_t loadTrafficProfiles(const string& path) {
+        CsvReader csv;
+        if (!csv.open(path, false)) return 0;
+        lock_guard<mutex> lock(trafficMutex);
+        size_t loaded = 0;
+        while (csv.next()) {
+            NodeId a = findLocation(csv[0]), b = findLocation(csv[1]);
+            auto edge = edgeByPair.find(nodePairKey(a, b));
+            if (a == INVALID_NODE || b == INVALID_NODE || edge == edgeByPair.end()) continue;
+            array<float, 24> profile;
+            int hour = 0;
+            while (hour < 24 && csv.parse(2 + hour, profile[hour])) hour++;
+            if (hour != 24) { csv.reject("expected from,to and 24 hourly speed factors"); continue; }
+            traffic.setProfile(edge->second, profile);
+            loaded++;
+        }
+        if (loaded) etaCache.clear();
+        return loaded;
+    }
+    size_t applyTrafficUpdates(const string& path, time_t now) {
+        CsvReader csv;
+        if (!csv.open(path, false)) return 0;
+        lock_guard<mutex> lock(trafficMutex);
+        vector<uint32_t> slowed;
+        bool fasterSomewhere = false;
+        size_t applied = 0;
+        while (csv.next()) {
+            NodeId a = findLocation(csv[0]), b = findLocation(csv[1]);
+            auto edge = edgeByPair.find(nodePairKey(a, b));
+            if (a == INVALID_NODE || b == INVALID_NODE || edge == edgeByPair.end()) continue;
+            float factor, minutes = TRAFFIC_UPDATE_TTL / 60.0f;
+            if (!csv.parse(2, factor) || factor <= 0.0f || (!csv[3].empty() && !csv.parse(3, minutes))) {
+                csv.reject("expected from,to,speed factor[,minutes]");
+                continue;
+            }
+            int64_t ttl = static_cast<int64_t>(minutes * 60);
+            float previous = traffic.currentFactor(edge->second, now);
+            traffic.setLive(edge->second, factor, static_cast<int64_t>(now) + ttl);
+            etaCache.expireAt(static_cast<int64_t>(now) + ttl);
+            if (factor < previous) slowed.push_back(edge->second);
+            else if (factor > previous) fasterSomewhere = true;
+            applied++;
+        }
+        if (fasterSomewhere) etaCache.clear();
+        else etaCache.invalidate(slowed);
+        return applied;
+    }
+    const TrafficModel& getTraffic() const { return traffic; }
+    const EtaCache& getEtaCache() const { return etaCache; }
+    bool loadEdgesCsv(const string& path) {
+        CsvReader csv;
+        if (!csv.open(path, true)) return false;
+        while (csv.next()) {
+            float distance;
+            if (csv[0].empty() || csv[1].empty() || !csv.parse(2, distance)) { csv.reject("expected from,to,distance"); continue; }
+            stageEdge(csv[0], csv[1], distance);
+        }
+        buildAdjacency();
+        return true;
+    }
+    size_t loadCoordinatesCsv(const string& path) {
+        CsvReader csv;
+        if (!csv.open(path, true)) return 0;
+        size_t loaded = 0;
+        while (csv.next()) {
+            float lat, lon;
+            if (!csv.parse(1, lat) || !csv.parse(2, lon)) { csv.reject("expected location,latitude,longitude"); continue; }
+            if (addLocation(csv[0], lat, lon)) loaded++;
+        }
+        return loaded;
+    }
+};
+
+enum class VehicleClass : uint8_t { TwoWheeler, FourSeater, SevenSeater, Count };
+const size_t VEHICLE_CLASSES = static_cast<size_t>(VehicleClass::Count);
+
+VehicleClass vehicleClassOf(string_view vehicle) {
+    return vehicle == "2-wheeler" ? VehicleClass::TwoWheeler : vehicle == "4-seater" ? VehicleClass::FourSeater
+         : vehicle == "7-seater" ? VehicleClass::SevenSeater : VehicleClass::Count;
+}
+
+const char* vehicleName(VehicleClass vehicle) {
+    static const char* names[VEHICLE_CLASSES] = {"2-wheeler", "4-seater", "7-seater"};
+    return vehicle < VehicleClass::Count ? names[static_cast<size_t>(vehicle)] : "";
+}
+
+class SurgeEngine {
+private:
+    static const size_t WINDOW_BUCKETS = 20;
+    static const uint64_t COUNT_BITS = 24;
+    static const uint64_t COUNT_MASK = (uint64_t(1) << COUNT_BITS) - 1;
+    // Each bucket packs its epoch above the count so a stale bucket is recycled by the same CAS that increments it.
+    struct alignas(64) Cell {
+        array<atomic<uint64_t>, WINDOW_BUCKETS> requests{};
+        atomic<int32_t> available{0};
+    };
+    const Graph* graph = nullptr;
+    vector<uint32_t> zoneOfNode;
+    unique_ptr<Cell[]> cells;
+    size_t zones = 0;
+    static int64_t bucketSeconds() { return max<int64_t>(1, SURGE_WINDOW.count() / WINDOW_BUCKETS); }
+    Cell* cellFor(NodeId node, VehicleClass vehicle) const {
+        if (!cells || vehicle >= VehicleClass::Count || node == INVALID_NODE) return nullptr;
+        uint32_t zone = node < zoneOfNode.size() ? zoneOfNode[node] : 0;
+        return &cells[zone * VEHICLE_CLASSES + static_cast<size_t>(vehicle)];
+    }
+    void resetSupply() {
+        for (size_t i = 0; i < zones * VEHICLE_CLASSES; i++) cells[i].available.store(0, memory_order_relaxed);
+    }
+    static size_t windowRequests(const Cell& cell, time_t when) {
+        uint64_t epoch = static_cast<uint64_t>(when / bucketSeconds());
+        size_t total = 0;
+        for (const auto& bucket : cell.requests) {
+            uint64_t packed = bucket.load(memory_order_relaxed);
+            if ((packed >> COUNT_BITS) + WINDOW_BUCKETS > epoch && (packed >> COUNT_BITS) <= epoch) total += packed & COUNT_MASK;
+        }
+        return total;
+    }
+    static float cellMultiplier(const Cell& cell, time_t when) {
+        size_t demand = windowRequests(cell, when);
+        if (demand < SURGE_MIN_REQUESTS) return 1.0f;
+        float pressure = static_cast<float>(demand) / max(1, cell.available.load(memory_order_relaxed));
+        float raw = min(SURGE_CAP, 1.0f + SURGE_STEP * (pressure - 1.0f));
+        return max(1.0f, floor(raw * 20.0f) / 20.0f);
+    }
+public:
+    void attach(const Graph& cityMap) {
+        if (graph == &cityMap && zoneOfNode.size() == cityMap.nodeCount()) { resetSupply(); return; }
+        graph = &cityMap;
+        unordered_map<int64_t, uint32_t> zoneByCell;
+        zoneOfNode.assign(cityMap.nodeCount(), 0);
+        for (NodeId node = 0; node < zoneOfNode.size(); node++) {
+            float lat, lon;
+            if (!cityMap.coordinates(node, lat, lon)) continue;
+            int64_t row = static_cast<int64_t>(floor(lat / SURGE_ZONE_DEG)), col = static_cast<int64_t>(floor(lon / SURGE_ZONE_DEG));
+            zoneOfNode[node] = zoneByCell.emplace((row << 32) ^ static_cast<uint32_t>(col), zoneByCell.size() + 1).first->second;
+        }
+        zones = zoneByCell.size() + 1;
+        cells.reset(new Cell[zones * VEHICLE_CLASSES]);
+    }
+    void recordRequest(NodeId node, VehicleClass vehicle, time_t when) {
+        Cell* cell = cellFor(node, vehicle);
+        if (!cell) return;
+        uint64_t epoch = static_cast<uint64_t>(when / bucketSeconds());
+        atomic<uint64_t>& bucket = cell->requests[epoch % WINDOW_BUCKETS];
+        uint64_t current = bucket.load(memory_order_relaxed), next;
+        do {
+            if ((current >> COUNT_BITS) > epoch) return;
+            if ((current >> COUNT_BITS) < epoch) next = (epoch << COUNT_BITS) | 1;
+            else if ((current & COUNT_MASK) == COUNT_MASK) return;
+            else next = current + 1;
+        } while (!bucket.compare_exchange_weak(current, next, memory_order_relaxed));
+    }
+    void adjustSupply(NodeId node, VehicleClass vehicle, int delta) {
+        if (Cell* cell = cellFor(node, vehicle)) cell->available.fetch_add(delta, memory_order_relaxed);
+    }
+    size_t recentRequests(NodeId node, VehicleClass vehicle, time_t when) const {
+        const Cell* cell = cellFor(node, vehicle);
+        return cell ? windowRequests(*cell, when) : 0;
+    }
+    float multiplier(NodeId node, VehicleClass vehicle, time_t when) const {
+        const Cell* cell = cellFor(node, vehicle);
+        return cell ? cellMultiplier(*cell, when) : 1.0f;
+    }
+    pair<size_t, float> surgingZones(time_t when) const {
+        size_t surging = 0;
+        float peak = 1.0f;
+        for (size_t i = 0; i < zones * VEHICLE_CLASSES; i++) {
+            float value = cellMultiplier(cells[i], when);
+            if (value > 1.0f) { surging++; peak = max(peak, value); }
+        }
+        return {surging, peak};
+    }
+    size_t zoneCount() const { return zones; }
+};
+
+class Driver {
+public:
+    string name, phone, location, vehicleType;
+    VehicleClass vehicleClass = VehicleClass::Count;
+    atomic<bool> available;
+    NodeId node = INVALID_NODE;
+    Driver() : available(false) {}
+    Driver(const string& n, const string& p, const string& loc, const string& vt, bool avail = true)
+        : name(n), phone(p), location(loc), vehicleType(vt), vehicleClass(vehicleClassOf(vt)), available(avail) {}
+    Driver(const Driver& other)
+        : name(other.name), phone(other.phone), location(other.location), vehicleType(other.vehicleType),
+          vehicleClass(other.vehicleClass), available(other.available.load()), node(other.node) {}
+    Driver& operator=(const Driver& other) {
+        name = other.name; phone = other.phone; location = other.location; vehicleType = other.vehicleType;
+        vehicleClass = other.vehicleClass; available = other.available.load(); node = other.node;
+        return *this;
+    }
+    void displayInfo() const {
+        cout << "\n=== Driver Information ===\nName: " << name << "\nPhone: " << phone
+             << "\nLocation: " << location << "\nVehicle: " << vehicleType 
+             << "\nStatus: " << (available ? "Available" : "On Ride") << "\n";
+    }
+    void toggleAvailability() { available = !available.load(); }
+    string csvLine() const {
+        return name + "," + phone + "," + location + "," + vehicleType + "," + (available ? "1" : "0");
+    }
+};
+
+class DriverIndex {
+private:
+    struct VehicleBucket {
+        unordered_map<NodeId, vector<size_t>> byNode;
+        unordered_map<int64_t, vector<pair<size_t, NodeId>>> byCell;
+        size_t available = 0;
+    };
+    static constexpr float CELL_DEG = 0.02f;
+    static constexpr float CELL_KM = CELL_DEG * 111.2f * 0.87f;
+    Graph* graph = nullptr;
+    array<VehicleBucket, VEHICLE_CLASSES> buckets;
+    static int64_t cellKey(int32_t row, int32_t col) { return (static_cast<int64_t>(row) << 32) ^ static_cast<uint32_t>(col); }
+    bool cellOf(NodeId node, int32_t& row, int32_t& col) const {
+        float lat, lon;
+        if (!graph->coordinates(node, lat, lon)) return false;
+        row = static_cast<int32_t>(floor(lat / CELL_DEG)); col = static_cast<int32_t>(floor(lon / CELL_DEG));
+        return true;
+    }
+    template <typename T>
+    static void eraseValue(vector<T>& values, const T& value) {
+        auto it = find(values.begin(), values.end(), value);
+        if (it != values.end()) { *it = values.back(); values.pop_back(); }
+    }
+    bool anyWithin(const VehicleBucket& bucket, NodeId source, float radiusKm) const {
+        int32_t row, col;
+        if (radiusKm == INF || !cellOf(source, row, col) || graph->getHeuristicScale() <= 0) return true;
+        auto inRange = [&](const vector<pair<size_t, NodeId>>& cell) {
+            for (const auto& entry : cell) if (graph->distanceLowerBound(entry.second, source) <= radiusKm) return true;
+            return false;
+        };
+        float rings = ceil(radiusKm / graph->getHeuristicScale() / CELL_KM) + 1;
+        if ((2 * rings + 1) * (2 * rings + 1) > bucket.byCell.size()) {
+            for (const auto& [key, cell] : bucket.byCell) if (inRange(cell)) return true;
+            return false;
+        }
+        for (int32_t r = 0; r <= rings; r++) {
+            for (int32_t dr = -r; dr <= r; dr++) {
+                for (int32_t dc = -r; dc <= r; dc += (abs(dr) == r ? 1 : 2 * r)) {
+                    auto it = bucket.byCell.find(cellKey(row + dr, col + dc));
+                    if (it != bucket.byCell.end() && inRange(it->second)) return true;
+                    if (r == 0) break;
+                }
+            }
+        }
+        return false;
+    }
+public:
+    void attach(Graph* cityMap) { graph = cityMap; buckets = {}; }
+    bool attached() const { return graph != nullptr; }
+    void insert(VehicleClass vehicle, NodeId node, size_t slot) {
+        if (!graph || node == INVALID_NODE || vehicle >= VehicleClass::Count) return;
+        VehicleBucket& bucket = buckets[static_cast<size_t>(vehicle)];
+        bucket.byNode[node].push_back(slot);
+        int32_t row, col;
+        if (cellOf(node, row, col)) bucket.byCell[cellKey(row, col)].emplace_back(slot, node);
+        bucket.available++;
+    }
+    void erase(VehicleClass vehicle, NodeId node, size_t slot) {
+        if (!graph || node == INVALID_NODE || vehicle >= VehicleClass::Count) return;
+        VehicleBucket& bucket = buckets[static_cast<size_t>(vehicle)];
+        auto nodeIt = bucket.byNode.find(node);
+        if (nodeIt == bucket.byNode.end()) return;
+        eraseValue(nodeIt->second, slot);
+        if (nodeIt->second.empty()) bucket.byNode.erase(nodeIt);
+        int32_t row, col;
+        if (cellOf(node, row, col)) {
+            auto cellIt = bucket.byCell.find(cellKey(row, col));
+            if (cellIt != bucket.byCell.end()) {
+                eraseValue(cellIt->second, make_pair(slot, node));
+                if (cellIt->second.empty()) bucket.byCell.erase(cellIt);
+            }
+        }
+        bucket.available--;
+    }
+    vector<pair<size_t, float>> nearest(VehicleClass vehicle, NodeId source, size_t k, float maxDist) {
+        vector<pair<size_t, float>> found;
+        if (!graph || source == INVALID_NODE || vehicle >= VehicleClass::Count) return found;
+        const VehicleBucket& bucket = buckets[static_cast<size_t>(vehicle)];
+        if (bucket.available == 0) return found;
+        if (!anyWithin(bucket, source, maxDist)) return found;
+        graph->searchFrom(source, maxDist, [&](NodeId u, float d) {
+            auto slots = bucket.byNode.find(u);
+            if (slots != bucket.byNode.end()) for (size_t slot : slots->second) found.emplace_back(slot, d);
+            return found.size() < k;
+        });
+        return found;
+    }
+};
+
+// Fleet columns plus one availability bitset per vehicle class.
+class FleetTable {
+private:
+    vector<string> names, phones, locationNames;
+    vector<uint32_t> locationIds;
+    vector<VehicleClass> classes;
+    vector<NodeId> nodes;
+    unordered_map<string, uint32_t> locationByKey, rowByPhone;
+    array<vector<atomic<uint64_t>>, VEHICLE_CLASSES> availableBits;
+    static int lowestBit(uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctzll(word);
+#else
+        int bit = 0;
+        while (!(word & 1)) { word >>= 1; bit++; }
+        return bit;
+#endif
+    }
+    atomic<uint64_t>& wordOf(uint32_t row) { return availableBits[static_cast<size_t>(classes[row])][row / 64]; }
+    const atomic<uint64_t>& wordOf(uint32_t row) const { return availableBits[static_cast<size_t>(classes[row])][row / 64]; }
+    // Atomics cannot be moved, so growing copies the words; callers hold the fleet lock exclusively.
+    void growBits(size_t rows) {
+        size_t words = (rows + 63) / 64;
+        if (words <= availableBits[0].size()) return;
+        words = max(words, 2 * availableBits[0].size());
+        for (auto& bits : availableBits) {
+            vector<atomic<uint64_t>> grown(words);
+            for (size_t w = 0; w < bits.size(); w++) grown[w].store(bits[w].load(memory_order_relaxed), memory_order_relaxed);
+            bits.swap(grown);
+        }
+    }
+public:
+    size_t size() const { return phones.size(); }
+    void clear() {
+        names.clear(); phones.clear(); locationNames.clear();
+        locationIds.clear(); classes.clear(); nodes.clear();
+        locationByKey.clear(); rowByPhone.clear();
+        for (auto& bits : availableBits) vector<atomic<uint64_t>>().swap(bits);
+    }
+    uint32_t internLocation(const string& location) {
+        auto [it, added] = locationByKey.emplace(normalize(location), static_cast<uint32_t>(locationNames.size()));
+        if (added) locationNames.push_back(location);
+        return it->second;
+    }
+    bool findLocation(const string& location, uint32_t& id) const {
+        auto it = locationByKey.find(normalize(location));
+        if (it == locationByKey.end()) return false;
+        id = it->second;
+        return true;
+    }
+    bool find(const string& phone, uint32_t& row) const {
+        auto it = rowByPhone.find(phone);
+        if (it == rowByPhone.end()) return false;
+        row = it->second;
+        return true;
+    }
+    uint32_t upsert(const Driver& driver) {
+        auto [it, added] = rowByPhone.emplace(driver.phone, static_cast<uint32_t>(phones.size()));
+        uint32_t row = it->second;
+        if (added) {
+            names.push_back(driver.name); phones.push_back(driver.phone);
+            locationIds.push_back(0); classes.push_back(driver.vehicleClass); nodes.push_back(INVALID_NODE);
+            growBits(phones.size());
+        } else {
+            setAvailable(row, false);
+            names[row] = driver.name;
+            classes[row] = driver.vehicleClass;
+        }
+        locationIds[row] = internLocation(driver.location);
+        nodes[row] = driver.node;
+        setAvailable(row, driver.available);
+        return row;
+    }
+    void resolveNodes(const Graph& cityMap) {
+        vector<NodeId> nodeOfLocation(locationNames.size());
+        for (uint32_t id = 0; id < locationNames.size(); id++) nodeOfLocation[id] = cityMap.findLocation(locationNames[id]);
+        for (uint32_t row = 0; row < size(); row++) nodes[row] = nodeOfLocation[locationIds[row]];
+    }
+    void relocate(uint32_t row, const string& location, NodeId node) {
+        locationIds[row] = internLocation(location);
+        nodes[row] = node;
+    }
+    const string& phone(uint32_t row) const { return phones[row]; }
+    const string& location(uint32_t row) const { return locationNames[locationIds[row]]; }
+    uint32_t locationId(uint32_t row) const { return locationIds[row]; }
+    VehicleClass vehicleClass(uint32_t row) const { return classes[row]; }
+    NodeId node(uint32_t row) const { return nodes[row]; }
+    bool available(uint32_t row) const { return wordOf(row).load(memory_order_acquire) >> (row % 64) & 1; }
+    bool setAvailable(uint32_t row, bool available) {
+        uint64_t mask = uint64_t(1) << (row % 64);
+        atomic<uint64_t>& word = wordOf(row);
+        uint64_t before = available ? word.fetch_or(mask, memory_order_acq_rel) : word.fetch_and(~mask, memory_order_acq_rel);
+        return ((before & mask) != 0) != available;
+    }
+    size_t availableCount(VehicleClass vehicle) const {
+        size_t count = 0;
+        for (const auto& word : availableBits[static_cast<size_t>(vehicle)]) count += bitset<64>(word.load(memory_order_relaxed)).count();
+        return count;
+    }
+    template <typename Visit>
+    void forEachAvailable(VehicleClass vehicle, Visit&& visit) const {
+        const auto& bits = availableBits[static_cast<size_t>(vehicle)];
+        for (size_t w = 0; w < bits.size(); w++) {
+            for (uint64_t word = bits[w].load(memory_order_relaxed); word != 0; word &= word - 1) {
+                if (!visit(static_cast<uint32_t>(w * 64 + lowestBit(word)))) return;
+            }
+        }
+    }
+    Driver row(uint32_t row) const {
+        Driver driver(names[row], phones[row], location(row), vehicleName(classes[row]), available(row));
+        driver.node = nodes[row];
+        return driver;
+    }
+    string csvLine(uint32_t row) const {
+        return names[row] + "," + phones[row] + "," + location(row) + "," + vehicleName(classes[row]) + "," + (available(row) ? "1" : "0");
+    }
+};
+
+class DriverManager {
+private:
+    static const size_t ROW_SHARDS = 64;
+    FleetTable fleet;
+    DriverIndex index;
+    SurgeEngine surge;
+    mutable shared_mutex fleetMutex, indexMutex;
+    array<mutex, ROW_SHARDS> rowLocks;
+    GroupCommitWriter writer{DRIVERS_FILE, Metric::SaveDrivers, PERSIST_INTERVAL, PERSIST_BATCH_SIZE};
+    Graph* cityMap = nullptr;
+    mutex& rowLock(uint32_t row) { return rowLocks[row % ROW_SHARDS]; }
+    void indexDriver(uint32_t row) {
+        if (!cityMap || !fleet.available(row)) return;
+        index.insert(fleet.vehicleClass(row), fleet.node(row), row);
+        surge.adjustSupply(fleet.node(row), fleet.vehicleClass(row), 1);
+    }
+    void reindex() {
+        if (!cityMap) return;
+        fleet.resolveNodes(*cityMap);
+        index.attach(cityMap);
+        surge.attach(*cityMap);
+        for (uint32_t row = 0; row < fleet.size(); row++) indexDriver(row);
+    }
+    static vector<Driver> defaultDrivers() {
+        return {
+            Driver("Ramesh", "9990010001", "Connaught Place", "2-wheeler", true),
+            Driver("Neha", "9990051112", "Lajpat Nagar", "2-wheeler", true),
+            Driver("Anil", "9991012223", "RK Puram", "4-seater", true),
+            Driver("Sita", "9992023334", "Saket", "7-seater", true),
+            Driver("Aman", "9993034445", "Jasola", "4-seater", true),
+            Driver("Priya", "9994045556", "Tilak Nagar", "2-wheeler", true),
+            Driver("Deepak", "9995056667", "Dwarka", "4-seater", true),
+            Driver("Komal", "9996067778", "Janakpuri", "2-wheeler", true),
+            Driver("Manoj", "9997078889", "Karol Bagh", "7-seater", true),
+            Driver("Tina", "9998089990", "Green Park", "2-wheeler", true),
+            Driver("Rahul", "9999099999", "Saket", "4-seater", true),
+            Driver("Vikram", "9999098888", "Saket", "7-seater", true),
+            Driver("Sunita", "9999097777", "Lajpat Nagar", "7-seater", true)
+        };
+    }
+public:
+    DriverManager() { loadDrivers(); }
+    void loadDrivers() {
+        writer.flush();
+        unique_lock<shared_mutex> fleetLock(fleetMutex);
+        unique_lock<shared_mutex> indexLock(indexMutex);
+        fleet.clear();
+        CsvReader csv;
+        if (!csv.open(DRIVERS_FILE, false)) {
+            cout << "No driver file found or empty. Initializing default drivers...\n";
+            for (const Driver& driver : defaultDrivers()) fleet.upsert(driver);
+            saveDrivers();
+            reindex();
+            cout << "Initialized " << fleet.size() << " default drivers.\n";
+            return;
+        }
+        cout << "Loading drivers from " << DRIVERS_FILE << ":\n";
+        while (csv.next()) {
+            if (csv[0].empty() || csv[1].empty() || csv[2].empty() || csv[3].empty()) {
+                csv.reject("missing name, phone, location or vehicle type");
+                continue;
+            }
+            if (vehicleClassOf(csv[3]) == VehicleClass::Count) {
+                csv.reject("unknown vehicle type");
+                continue;
+            }
+            bool available = csv[4] == "1" || csv[4] == "true";
+            fleet.upsert(Driver(string(csv[0]), string(csv[1]), string(csv[2]), string(csv[3]), available));
+        }
+        for (uint32_t row = 0; row < fleet.size(); row++) {
+            Driver driver = fleet.row(row);
+            cout << "Loaded driver: " << driver.name << ", " << driver.phone << ", " << driver.vehicleType << "\n";
+        }
+        bool hasTwoWheeler = fleet.availableCount(VehicleClass::TwoWheeler) > 0, hasSevenSeaterSaket = false;
+        uint32_t saket;
+        if (fleet.findLocation("Saket", saket)) {
+            fleet.forEachAvailable(VehicleClass::SevenSeater, [&](uint32_t row) { return !(hasSevenSeaterSaket = fleet.locationId(row) == saket); });
+        }
+        if (!hasTwoWheeler) {
+            fleet.upsert(Driver("Ramesh", "9990010001", "Connaught Place", "2-wheeler", true));
+            cout << "Added 2-wheeler driver.\n";
+        }
+        if (!hasSevenSeaterSaket) {
+            fleet.upsert(Driver("Vikram", "9999098888", "Saket", "7-seater", true));
+            cout << "Added 7-seater driver at Saket.\n";
+        }
+        saveDrivers();
+        reindex();
+        cout << "Loaded " << fleet.size() << " drivers.\n";
+    }
+    void attachMap(Graph& graph) {
+        unique_lock<shared_mutex> fleetLock(fleetMutex);
+        unique_lock<shared_mutex> indexLock(indexMutex);
+        cityMap = &graph;
+        reindex();
+    }
+    void registerNewDriver() {
+        string name, phone, location, vehicle;
+        cout << "Enter your name: "; getline(cin, name);
+        while (true) {
+            cout << "Phone number (10 digits): "; getline(cin, phone);
+            if (phone.length() == 10 && all_of(phone.begin(), phone.end(), ::isdigit)) break;
+            cout << "Invalid number! Try again.\n";
+        }
+        cout << "Enter your current location: "; getline(cin, location);
+        cout << "Select vehicle (1 = 2-wheeler, 2 = 4-seater, 3 = 7-seater): ";
+        int choice; cin >> choice; cin.ignore();
+        if (choice == 1) vehicle = "2-wheeler";
+        else if (choice == 2) vehicle = "4-seater";
+        else if (choice == 3) vehicle = "7-seater";
+        else { cout << "Invalid choice. Registration failed.\n"; return; }
+        unique_lock<shared_mutex> fleetLock(fleetMutex);
+        unique_lock<shared_mutex> indexLock(indexMutex);
+        uint32_t row;
+        if (fleet.find(phone, row)) { cout << "Driver already registered!\n"; return; }
+        Driver driver(name, phone, location, vehicle);
+        if (cityMap) driver.node = cityMap->findLocation(location);
+        row = fleet.upsert(driver);
+        indexDriver(row);
+        writer.upsert(phone, fleet.csvLine(row));
+        cout << "Driver registered successfully!\n";
+    }
+    void saveDrivers() {
+        vector<pair<string, string>> lines;
+        for (uint32_t row = 0; row < fleet.size(); row++) lines.emplace_back(fleet.phone(row), fleet.csvLine(row));
+        if (!writer.replaceAll(lines)) {
+            cerr << "Error: Could not write " << DRIVERS_FILE << ".\n";
+            return;
+        }
+        cout << "Saved " << lines.size() << " drivers to " << DRIVERS_FILE << ".\n";
+    }
+    vector<Driver> getAllDrivers() const {
+        shared_lock<shared_mutex> fleetLock(fleetMutex);
+        vector<Driver> all;
+        all.reserve(fleet.size());
+        for (uint32_t row = 0; row < fleet.size(); row++) all.push_back(fleet.row(row));
+        return all;
+    }
+    SurgeEngine& surgePricing() { return surge; }
+    bool setAvailability(const string& phone, bool available) {
+        shared_lock<shared_mutex> fleetLock(fleetMutex);
+        uint32_t row;
+        if (!fleet.find(phone, row)) return false;
+        // Flips of one row run in order, so the index, supply and queued CSV line all follow the last flip.
+        lock_guard<mutex> ordered(rowLock(row));
+        if (!fleet.setAvailable(row, available)) return false;
+        VehicleClass vehicle = fleet.vehicleClass(row);
+        NodeId node = fleet.node(row);
+        {
+            unique_lock<shared_mutex> indexLock(indexMutex);
+            if (available) index.insert(vehicle, node, row);
+            else index.erase(vehicle, node, row);
+        }
+        surge.adjustSupply(node, vehicle, available ? 1 : -1);
+        writer.upsert(phone, fleet.csvLine(row));
+        return true;
+    }
+    bool relocateDriver(const string& phone, const string& location) {
+        unique_lock<shared_mutex> fleetLock(fleetMutex);
+        uint32_t row;
+        if (!fleet.find(phone, row) || fleet.available(row)) return false;
+        fleet.relocate(row, location, cityMap ? cityMap->findLocation(location) : INVALID_NODE);
+        return true;
+    }
+    bool getDriver(const string& phone, Driver& found) const {
+        shared_lock<shared_mutex> fleetLock(fleetMutex);
+        uint32_t row;
+        if (!fleet.find(phone, row)) return false;
+        found = fleet.row(row);
+        return true;
+    }
+    bool reserveDriver(const string& phone) { return setAvailability(phone, false); }
+    bool releaseDriver(const string& phone) { return setAvailability(phone, true); }
+    void toggleDriverAvailability(const string& phone) {
+        bool found = false, nowAvailable = false;
+        {
+            shared_lock<shared_mutex> fleetLock(fleetMutex);
+            uint32_t row;
+            if (fleet.find(phone, row)) { found = true; nowAvailable = !fleet.available(row); }
+        }
+        if (!found) { cout << "Driver not found!\n"; return; }
+        setAvailability(phone, nowAvailable);
+        cout << "Availability updated to: " << (nowAvailable ? "Available" : "On Ride") << "\n";
+    }
+    vector<pair<Driver, float>> nearestAvailable(VehicleClass vehicle, NodeId source, size_t k, float maxDist) {
+        shared_lock<shared_mutex> fleetLock(fleetMutex);
+        vector<pair<size_t, float>> slots;
+        {
+            shared_lock<shared_mutex> indexLock(indexMutex);
+            slots = index.nearest(vehicle, source, k, maxDist);
+        }
+        vector<pair<Driver, float>> nearest;
+        for (auto [slot, dist] : slots) nearest.emplace_back(fleet.row(static_cast<uint32_t>(slot)), dist);
+        return nearest;
+    }
+    vector<Driver> availableDrivers(VehicleClass vehicle) const {
+        shared_lock<shared_mutex> fleetLock(fleetMutex);
+        vector<Driver> found;
+        if (vehicle >= VehicleClass::Count) return found;
+        fleet.forEachAvailable(vehicle, [&](uint32_t row) {
+            if (fleet.node(row) != INVALID_NODE) found.push_back(fleet.row(row));
+            return true;
+        });
+        return found;
+    }
+    size_t availableCount(VehicleClass vehicle) const {
+        shared_lock<shared_mutex> fleetLock(fleetMutex);
+        return fleet.availableCount(vehicle);
+    }
+    size_t getDriverCount() const {
+        shared_lock<shared_mutex> fleetLock(fleetMutex);
+        return fleet.size();
+    }
+};
+
+uint32_t crc32(string_view data) {
+    static const array<uint32_t, 256> table = [] {
+        array<uint32_t, 256> entries{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            entries[i] = c;
+        }
+        return entries;
+    }();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (unsigned char ch : data) crc = table[(crc ^ ch) & 0xff] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+class RideHistory {
+public:
+    // Names, locations and vehicle types repeat across millions of rows, so records hold views into sharedStrings().
+    struct RideRecord {
+        string bookingID;
+        string_view user;
+        string userPhone;
+        string_view source, destination, vehicleType;
+        float fare;
+        string_view driverName;
+        string driverPhone, timestamp;
+        float rating;
+    };
+private:
+    vector<RideRecord> records;
+    static const size_t COMPACTION_THRESHOLD = 1000;
+    FILE* journal = nullptr;
+    size_t journalRecords = 0;
+    mutex journalMutex;
+    thread compactor;
+    atomic<bool> compacting{false};
+    unordered_map<string, size_t> byBooking;
+    unordered_map<string, vector<size_t>> byUser, byDriver;
+    uint64_t ratingVersion = 0;
+    uint64_t nextBookingNumber = 10000;
+    mutable mutex recordsMutex;
+    static string compactingPath() { return RIDE_JOURNAL + ".compacting"; }
+    static string formatRecord(const RideRecord& record) {
+        ostringstream out;
+        out << record.bookingID << "," << record.user << "," << record.userPhone << ","
+            << record.source << "," << record.destination << "," << record.vehicleType << ","
+            << record.fare << "," << record.driverName << "," << record.driverPhone << ","
+            << record.timestamp << "," << (record.rating > 0 ? to_string(record.rating) : "");
+        return out.str();
+    }
+    static bool parseRecord(const string_view* fields, size_t count, RideRecord& record) {
+        if (count < 10 || fields[0].empty()) return false;
+        StringArena& strings = sharedStrings();
+        record.rating = 0.0f;
+        if (!CsvReader::parse(fields[6], record.fare)) return false;
+        if (count > 10 && !fields[10].empty() && !CsvReader::parse(fields[10], record.rating)) return false;
+        record.bookingID.assign(fields[0]);
+        record.user = strings.intern(fields[1]);
+        record.userPhone.assign(fields[2]);
+        record.source = strings.intern(fields[3]);
+        record.destination = strings.intern(fields[4]);
+        record.vehicleType = strings.intern(fields[5]);
+        record.driverName = strings.intern(fields[7]);
+        record.driverPhone.assign(fields[8]);
+        record.timestamp.assign(fields[9]);
+        return true;
+    }
+    static void loadSnapshot(vector<RideRecord>& into, unordered_map<string, size_t>& byBooking) {
+        CsvReader csv;
+        if (!csv.open(RIDE_HISTORY, true)) return;
+        string_view fields[CsvReader::MAX_FIELDS];
+        RideRecord record;
+        size_t expected = csv.fileSize() / 96;
+        into.reserve(into.size() + expected);
+        byBooking.reserve(byBooking.size() + expected);
+        while (csv.next()) {
+            for (size_t i = 0; i < csv.size(); i++) fields[i] = csv[i];
+            if (!parseRecord(fields, csv.size(), record)) { csv.reject("expected 11 ride fields with numeric fare and rating"); continue; }
+            byBooking.insert_or_assign(record.bookingID, into.size());
+            into.push_back(move(record));
+        }
+    }
+    static size_t replayJournal(const string& path, vector<RideRecord>& into, unordered_map<string, size_t>& byBooking) {
+        CsvReader csv;
+        if (!csv.open(path, false)) return 0;
+        string_view fields[CsvReader::MAX_FIELDS];
+        size_t replayed = 0;
+        while (csv.next()) {
+            string_view line = csv.row();
+            size_t split = line.rfind(',');
+            uint32_t stored;
+            if (split == string_view::npos || split < 2) { csv.reject("truncated journal entry"); continue; }
+            string_view payload = line.substr(0, split), checksum = line.substr(split + 1);
+            auto parsed = from_chars(checksum.data(), checksum.data() + checksum.size(), stored, 16);
+            if (parsed.ec != errc() || parsed.ptr != checksum.data() + checksum.size() || crc32(payload) != stored) {
+                csv.reject("checksum mismatch");
+                continue;
+            }
+            size_t count = CsvReader::split(payload.substr(2), fields, CsvReader::MAX_FIELDS);
+            RideRecord record;
+            if (payload[0] == 'R' && parseRecord(fields, count, record)) {
+                byBooking.insert_or_assign(record.bookingID, into.size());
+                into.push_back(move(record));
+            } else if (payload[0] == 'T' && count >= 2) {
+                float rating;
+                if (!CsvReader::parse(fields[1], rating)) { csv.reject("bad rating"); continue; }
+                auto it = byBooking.find(string(fields[0]));
+                if (it != byBooking.end()) into[it->second].rating = rating;
+            } else { csv.reject("unknown journal entry"); continue; }
+            replayed++;
+        }
+        return replayed;
+    }
+    static bool writeSnapshot(const vector<RideRecord>& snapshot) {
+        string tempPath = RIDE_HISTORY + ".tmp";
+        FILE* file = fopen(tempPath.c_str(), "wb");
+        if (!file) {
+            cerr << "Error: Could not open " << tempPath << " for writing.\n";
+            return false;
+        }
+        string buffer = "BookingID,User,UserPhone,Source,Destination,VehicleType,Fare,Driver,DriverPhone,Timestamp,Rating\n";
+        for (const auto& record : snapshot) { buffer += formatRecord(record); buffer += '\n'; }
+        bool written = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size() && syncFile(file);
+        fclose(file);
+        if (!written || rename(tempPath.c_str(), RIDE_HISTORY.c_str()) != 0) {
+            remove(tempPath.c_str());
+            return false;
+        }
+        syncDirectory(RIDE_HISTORY);
+        return true;
+    }
+    static bool pendingFold() {
+        struct stat info;
+        return stat(compactingPath().c_str(), &info) == 0;
+    }
+    // A crash between the snapshot rename and the remove leaves a journal whose rides already end the snapshot.
+    static bool alreadyFolded(const vector<RideRecord>& folded, size_t snapshotSize) {
+        size_t journaled = folded.size() - snapshotSize;
+        if (journaled == 0 || journaled > snapshotSize) return false;
+        for (size_t i = 0; i < journaled; i++) {
+            if (folded[snapshotSize - journaled + i].bookingID != folded[snapshotSize + i].bookingID) return false;
+        }
+        return true;
+    }
+    static bool foldJournal() {
+        vector<RideRecord> folded;
+        unordered_map<string, size_t> byBooking;
+        loadSnapshot(folded, byBooking);
+        size_t snapshotSize = folded.size();
+        replayJournal(compactingPath(), folded, byBooking);
+        if (alreadyFolded(folded, snapshotSize)) return remove(compactingPath().c_str()) == 0;
+        return writeSnapshot(folded) && remove(compactingPath().c_str()) == 0;
+    }
+    // Each entry is fsynced before the booking returns, so a crash can only tear the entry being written.
+    void appendJournal(const string& payload) {
+        lock_guard<mutex> lock(journalMutex);
+        ScopedTimer timer(Metric::SaveHistory);
+        if (!journal && !(journal = fopen(RIDE_JOURNAL.c_str(), "ab"))) {
+            cerr << "Error: Could not open " << RIDE_JOURNAL << " for writing.\n";
+            return;
+        }
+        char checksum[16];
+        snprintf(checksum, sizeof(checksum), "%x", crc32(payload));
+        string line = payload + "," + checksum + "\n";
+        if (fwrite(line.data(), 1, line.size(), journal) != line.size() || !syncFile(journal)) {
+            cerr << "Error: Could not write " << RIDE_JOURNAL << ".\n";
+        }
+        if (++journalRecords >= COMPACTION_THRESHOLD && !compacting) startCompaction();
+    }
+    void indexRecord(size_t slot) {
+        const string& id = records[slot].bookingID;
+        uint64_t number;
+        if (id.size() > 2 && id.compare(0, 2, "UB") == 0 && CsvReader::parse(string_view(id).substr(2), number)) {
+            nextBookingNumber = max(nextBookingNumber, number + 1);
+        }
+        byUser[records[slot].userPhone].push_back(slot);
+        if (!records[slot].driverPhone.empty()) byDriver[records[slot].driverPhone].push_back(slot);
+    }
+    vector<RideRecord> page(const unordered_map<string, vector<size_t>>& index, const string& phone, size_t pageNumber, size_t pageSize) const {
+        lock_guard<mutex> lock(recordsMutex);
+        vector<RideRecord> found;
+        auto it = index.find(phone);
+        if (it == index.end() || pageSize == 0) return found;
+        const vector<size_t>& slots = it->second;
+        for (size_t i = pageNumber * pageSize; i < min(slots.size(), (pageNumber + 1) * pageSize); i++) {
+            found.push_back(records[slots[slots.size() - 1 - i]]);
+        }
+        return found;
+    }
+    size_t countFor(const unordered_map<string, vector<size_t>>& index, const string& phone) const {
+        lock_guard<mutex> lock(recordsMutex);
+        auto it = index.find(phone);
+        return it == index.end() ? 0 : it->second.size();
+    }
+    // A journal left from a failed fold is folded before the next rotation, otherwise the rename would overwrite it.
+    void startCompaction() {
+        if (compactor.joinable()) compactor.join();
+        if (pendingFold() && !foldJournal()) return;
+        if (journal) { fclose(journal); journal = nullptr; }
+        if (rename(RIDE_JOURNAL.c_str(), compactingPath().c_str()) != 0) return;
+        journalRecords = 0;
+        compacting = true;
+        compactor = thread([this] { foldJournal(); compacting = false; });
+    }
+public:
+    ~RideHistory() {
+        if (compactor.joinable()) compactor.join();
+        if (journal) fclose(journal);
+    }
+    void loadHistory() {
+        lock_guard<mutex> lock(recordsMutex);
+        records.clear();
+        byBooking.clear(); byUser.clear(); byDriver.clear();
+        nextBookingNumber = 10000;
+        {
+            lock_guard<mutex> journalLock(journalMutex);
+            if (compactor.joinable()) compactor.join();
+            if (pendingFold()) foldJournal();
+        }
+        loadSnapshot(records, byBooking);
+        journalRecords = replayJournal(RIDE_JOURNAL, records, byBooking);
+        for (size_t slot = 0; slot < records.size(); slot++) indexRecord(slot);
+    }
+    vector<RideRecord> userHistoryPage(const string& userPhone, size_t pageNumber, size_t pageSize = HISTORY_PAGE_SIZE) const {
+        return page(byUser, userPhone, pageNumber, pageSize);
+    }
+    vector<RideRecord> driverHistoryPage(const string& driverPhone, size_t pageNumber, size_t pageSize = HISTORY_PAGE_SIZE) const {
+        return page(byDriver, driverPhone, pageNumber, pageSize);
+    }
+    size_t userRideCount(const string& userPhone) const { return countFor(byUser, userPhone); }
+    size_t driverRideCount(const string& driverPhone) const { return countFor(byDriver, driverPhone); }
+    bool findBooking(const string& bookingID, RideRecord& record) const {
+        lock_guard<mutex> lock(recordsMutex);
+        auto it = byBooking.find(bookingID);
+        if (it == byBooking.end()) return false;
+        record = records[it->second];
+        return true;
+    }
+    size_t displayUserHistory(const string& userPhone, size_t pageNumber = 0) {
+        size_t total = userRideCount(userPhone);
+        size_t pages = (total + HISTORY_PAGE_SIZE - 1) / HISTORY_PAGE_SIZE;
+        cout << "\n=== Your Ride History ===\n";
+        if (total == 0) { cout << "No ride history found.\n"; return 0; }
+        for (const auto& record : userHistoryPage(userPhone, pageNumber)) {
+            cout << "Booking ID: " << record.bookingID << "\nFrom: " << record.source 
+                 << " To: " << record.destination << "\nVehicle: " << record.vehicleType
+                 << "\nDriver: " << record.driverName << " (" << record.driverPhone << ")\n"
+                 << "Fare: RS " << fixed << setprecision(2) << record.fare << "\nDate: " 
+                 << record.timestamp << "\nRating: " << (record.rating > 0 ? to_string(record.rating)+"/5" : "Not rated") << "\n------------------------\n";
+        }
+        cout << "Page " << pageNumber + 1 << " of " << pages << " (" << total << " rides)\n";
+        return pages;
+    }
+    bool addRating(const string& bookingID, float rating, RatingSystem& ratingSystem) {
+        lock_guard<mutex> lock(recordsMutex);
+        auto it = byBooking.find(bookingID);
+        if (it == byBooking.end() || records[it->second].rating != 0.0f) return false;
+        RideRecord& record = records[it->second];
+        record.rating = rating;
+        ratingVersion++;
+        ratingSystem.addRating(record.driverPhone, rating);
+        appendJournal("T," + bookingID + "," + to_string(rating));
+        return true;
+    }
+    void logRide(const string& bookingID, const string& user, const string& phone,
+                 const string& src, const string& dest, const string& vehicle,
+                 float fare, const Driver& driver) {
+        lock_guard<mutex> lock(recordsMutex);
+        time_t now = time(0);
+        string dt = ctime(&now); dt.pop_back();
+        StringArena& strings = sharedStrings();
+        records.push_back({bookingID, strings.intern(user), phone, strings.intern(src), strings.intern(dest),
+                           strings.intern(vehicle), fare, strings.intern(driver.name), driver.phone, dt, 0.0f});
+        byBooking[bookingID] = records.size() - 1;
+        indexRecord(records.size() - 1);
+        appendJournal("R," + formatRecord(records.back()));
+    }
+    size_t getRideCount() const {
+        lock_guard<mutex> lock(recordsMutex);
+        return records.size();
+    }
+    // Booking IDs count up from the highest one on file, so a new ride can never reuse an existing ID.
+    string nextBookingID() {
+        lock_guard<mutex> lock(recordsMutex);
+        return "UB" + to_string(nextBookingNumber++);
+    }
+    template <typename Visit>
+    size_t scanFrom(size_t from, Visit&& visit) const {
+        lock_guard<mutex> lock(recordsMutex);
+        for (size_t slot = from; slot < records.size(); slot++) visit(slot, records[slot]);
+        return records.size();
+    }
+    uint64_t getRatingVersion() const {
+        lock_guard<mutex> lock(recordsMutex);
+        return ratingVersion;
+    }
+};
+
+class Dictionary {
+private:
+    unordered_map<string_view, uint32_t> codes;
+    deque<string> values;
+public:
+    uint32_t encode(string_view value) {
+        auto it = codes.find(value);
+        if (it != codes.end()) return it->second;
+        values.emplace_back(value);
+        codes.emplace(values.back(), static_cast<uint32_t>(values.size() - 1));
+        return static_cast<uint32_t>(values.size() - 1);
+    }
+    const string& decode(uint32_t code) const { return values[code]; }
+    size_t size() const { return values.size(); }
+};
+
+class RideAnalytics {
+public:
+    struct RouteStat { uint32_t source, destination, rides; float revenue; };
+    struct DriverStat { uint32_t driver, rides; float earnings, rating; };
+private:
+    Dictionary locations, rawLocations, drivers, vehicles;
+    vector<uint32_t> canonicalLocation;
+    vector<string> driverNames;
+    unordered_map<uint64_t, uint32_t> routeCodes;
+    vector<pair<uint32_t, uint32_t>> routes;
+    vector<uint32_t> routeCol, driverCol;
+    vector<uint8_t> vehicleCol, hourCol;
+    vector<int64_t> epochCol;
+    vector<float> fareCol, ratingCol;
+    uint64_t ratingVersion = 0;
+    static bool parseTimestamp(const string& text, int64_t& epoch, uint8_t& hour) {
+        static const char* MONTHS = "JanFebMarAprMayJunJulAugSepOctNovDec";
+        if (text.size() != 24) return false;
+        auto digits = [&](size_t at, size_t count) {
+            int value = 0;
+            for (size_t i = at; i < at + count; i++) value = value * 10 + (isdigit(static_cast<unsigned char>(text[i])) ? text[i] - '0' : 0);
+            return value;
+        };
+        const char* found = strstr(MONTHS, text.substr(4, 3).c_str());
+        if (!found) return false;
+        tm when{};
+        when.tm_mday = digits(8, 2); when.tm_hour = digits(11, 2); when.tm_min = digits(14, 2);
+        when.tm_sec = digits(17, 2); when.tm_year = digits(20, 4);
+        int64_t year = when.tm_year, month = (found - MONTHS) / 3 + 1;
+        year -= month <= 2;
+        int64_t era = (year >= 0 ? year : year - 399) / 400, yearOfEra = year - era * 400;
+        int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + when.tm_mday - 1;
+        int64_t days = era * 146097 + yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear - 719468;
+        epoch = days * 86400 + when.tm_hour * 3600 + when.tm_min * 60 + when.tm_sec - localOffset();
+        hour = static_cast<uint8_t>(when.tm_hour);
+        return true;
+    }
+    uint32_t encodeLocation(string_view name) {
+        uint32_t raw = rawLocations.encode(name);
+        if (raw == canonicalLocation.size()) canonicalLocation.push_back(locations.encode(normalize(name)));
+        return canonicalLocation[raw];
+    }
+    static int64_t localOffset() {
+        static const int64_t offset = [] {
+            time_t now = time(0);
+            tm local{}, utc{};
+#ifdef _WIN32
+            localtime_s(&local, &now); gmtime_s(&utc, &now);
+#else
+            localtime_r(&now, &local); gmtime_r(&now, &utc);
+#endif
+            local.tm_isdst = utc.tm_isdst = 0;
+            return static_cast<int64_t>(difftime(mktime(&local), mktime(&utc)));
+        }();
+        return offset;
+    }
+public:
+    void refresh(const RideHistory& history) {
+        size_t expected = history.getRideCount();
+        if (expected > fareCol.size()) {
+            routeCodes.reserve(expected);
+            for (auto* column : {&routeCol, &driverCol}) column->reserve(expected);
+            for (auto* column : {&vehicleCol, &hourCol}) column->reserve(expected);
+            for (auto* column : {&fareCol, &ratingCol}) column->reserve(expected);
+            epochCol.reserve(expected);
+        }
+        history.scanFrom(fareCol.size(), [&](size_t, const RideHistory::RideRecord& record) {
+            int64_t epoch = 0;
+            uint8_t hour = 0;
+            parseTimestamp(record.timestamp, epoch, hour);
+            uint32_t source = encodeLocation(record.source), destination = encodeLocation(record.destination);
+            auto route = routeCodes.emplace((static_cast<uint64_t>(source) << 32) | destination, static_cast<uint32_t>(routes.size()));
+            if (route.second) routes.emplace_back(source, destination);
+            routeCol.push_back(route.first->second);
+            uint32_t driver = drivers.encode(record.driverPhone);
+            if (driver == driverNames.size()) driverNames.emplace_back(record.driverName);
+            driverCol.push_back(driver);
+            vehicleCol.push_back(static_cast<uint8_t>(vehicles.encode(record.vehicleType)));
+            epochCol.push_back(epoch);
+            hourCol.push_back(hour);
+            fareCol.push_back(record.fare);
+            ratingCol.push_back(record.rating);
+        });
+        uint64_t version = history.getRatingVersion();
+        if (version != ratingVersion) {
+            history.scanFrom(0, [&](size_t slot, const RideHistory::RideRecord& record) {
+                if (slot < ratingCol.size()) ratingCol[slot] = record.rating;
+            });
+            ratingVersion = version;
+        }
+    }
+    size_t rows() const { return fareCol.size(); }
+    const Dictionary& vehicleTypes() const { return vehicles; }
+    const string& locationName(uint32_t code) const { return locations.decode(code); }
+    const string& driverPhone(uint32_t code) const { return drivers.decode(code); }
+    const string& driverName(uint32_t code) const { return driverNames[code]; }
+    vector<float> revenueByHourAndVehicle() const {
+        size_t kinds = vehicles.size();
+        vector<float> revenue(24 * kinds, 0.0f);
+        const uint8_t* hours = hourCol.data();
+        const uint8_t* kindsCol = vehicleCol.data();
+        const float* fares = fareCol.data();
+        for (size_t i = 0, n = fareCol.size(); i < n; i++) revenue[hours[i] * kinds + kindsCol[i]] += fares[i];
+        return revenue;
+    }
+    vector<RouteStat> topRoutes(size_t k) const {
+        vector<uint32_t> rides(routes.size(), 0);
+        vector<float> revenue(routes.size(), 0.0f);
+        const uint32_t* codes = routeCol.data();
+        const float* fares = fareCol.data();
+        for (size_t i = 0, n = fareCol.size(); i < n; i++) {
+            rides[codes[i]]++;
+            revenue[codes[i]] += fares[i];
+        }
+        vector<uint32_t> order(routes.size());
+        iota(order.begin(), order.end(), 0);
+        size_t top = min(k, order.size());
+        partial_sort(order.begin(), order.begin() + top, order.end(),
+                     [&](uint32_t a, uint32_t b) { return rides[a] != rides[b] ? rides[a] > rides[b] : revenue[a] > revenue[b]; });
+        vector<RouteStat> stats;
+        for (size_t i = 0; i < top; i++) stats.push_back({routes[order[i]].first, routes[order[i]].second, rides[order[i]], revenue[order[i]]});
+        return stats;
+    }
+    vector<DriverStat> topDrivers(size_t k) const {
+        size_t count = drivers.size();
+        vector<float> earnings(count, 0.0f), ratingSum(count, 0.0f);
+        vector<uint32_t> rides(count, 0), rated(count, 0);
+        for (size_t i = 0, n = fareCol.size(); i < n; i++) {
+            uint32_t driver = driverCol[i];
+            earnings[driver] += fareCol[i];
+            rides[driver]++;
+            ratingSum[driver] += ratingCol[i];
+            rated[driver] += ratingCol[i] > 0.0f;
+        }
+        vector<DriverStat> stats;
+        for (uint32_t d = 0; d < count; d++) {
+            if (rides[d]) stats.push_back({d, rides[d], earnings[d], rated[d] ? ratingSum[d] / rated[d] : 0.0f});
+        }
+        size_t top = min(k, stats.size());
+        partial_sort(stats.begin(), stats.begin() + top, stats.end(),
+                     [](const DriverStat& a, const DriverStat& b) { return a.earnings > b.earnings; });
+        stats.resize(top);
+        return stats;
+    }
+    pair<float, size_t> averageRating() const {
+        double sum = 0.0;
+        size_t rated = 0;
+        const float* ratings = ratingCol.data();
+        for (size_t i = 0, n = ratingCol.size(); i < n; i++) {
+            sum += ratings[i];
+            rated += ratings[i] > 0.0f;
+        }
+        return {rated ? static_cast<float>(sum / rated) : 0.0f, rated};
+    }
+};
+
+class RidePool {
+public:
+    struct Stop {
+        NodeId node;
+        uint32_t rider;
+        bool pickup;
+    };
+    struct Insertion {
+        string driverPhone;
+        uint64_t version = 0;
+        size_t pickupGap = 0, dropoffGap = 0;
+        float addedKm = INF, pickupKm = INF;
+        float toPickup = 0.0f, fromPickup = 0.0f, toDropoff = 0.0f, fromDropoff = 0.0f;
+        bool found() const { return addedKm < INF; }
+    };
+private:
+    struct Rider {
+        float rideLimit, ridden = 0.0f, pickupLimit;
+        bool onboard = false;
+    };
+    // legKm[k] is the cached road distance into stops[k], so an insertion only needs distances to and from the new points.
+    struct Route {
+        VehicleClass vehicle = VehicleClass::Count;
+        size_t seats = 1, onboard = 0;
+        bool shareable = false;
+        NodeId position = INVALID_NODE;
+        vector<Stop> stops;
+        vector<float> legKm;
+        unordered_map<uint32_t, Rider> riders;
+        uint64_t version = 0;
+    };
+    // Gap g runs from point g to point g + 1, where point 0 is the vehicle and point k is stops[k - 1].
+    struct Layout {
+        vector<float> cum, gapSlack;
+        vector<size_t> load;
+        vector<tuple<size_t, size_t, const Rider*>> spans;
+    };
+    // An insertion of the new pickup into gap i and drop-off into gap j >= i, with straight-line lower bounds on its four new legs.
+    struct Option {
+        float bound;
+        size_t candidate, i, j;
+        array<float, 4> legBounds;
+    };
+    unordered_map<string, Route> routes;
+    mutable mutex poolMutex;
+    static NodeId pointOf(const Route& route, size_t k) { return k == 0 ? route.position : route.stops[k - 1].node; }
+    static Layout layout(const Route& route) {
+        Layout plan;
+        size_t n = route.stops.size();
+        plan.cum.assign(n + 1, 0.0f);
+        plan.load.assign(n, 0);
+        unordered_map<uint32_t, size_t> pickupPoint;
+        size_t onboard = route.onboard;
+        for (size_t k = 0; k < n; k++) {
+            plan.cum[k + 1] = plan.cum[k] + route.legKm[k];
+            plan.load[k] = onboard;
+            const Stop& stop = route.stops[k];
+            if (stop.pickup) { onboard++; pickupPoint[stop.rider] = k + 1; continue; }
+            onboard--;
+            auto it = route.riders.find(stop.rider);
+            if (it == route.riders.end()) continue;
+            auto picked = pickupPoint.find(stop.rider);
+            plan.spans.emplace_back(picked == pickupPoint.end() ? 0 : picked->second, k + 1, &it->second);
+        }
+        plan.gapSlack.assign(n, INF);
+        for (const auto& [a, b, rider] : plan.spans) {
+            float ride = plan.cum[b] - plan.cum[a] + rider->ridden;
+            for (size_t g = 0; g < n; g++) {
+                if (a <= g && g < b) plan.gapSlack[g] = min(plan.gapSlack[g], rider->rideLimit - ride);
+                else if (g < a) plan.gapSlack[g] = min(plan.gapSlack[g], rider->pickupLimit - plan.cum[a]);
+            }
+        }
+        return plan;
+    }
+    // Road distances replace the bounds one leg at a time, so most options are dropped after a query or two.
+    template <typename Distance>
+    static void evaluate(const Route& route, const Layout& plan, const Option& option, NodeId pickup, NodeId dropoff,
+                         float tripKm, float pickupLimit, Distance&& distance, Insertion& best) {
+        size_t n = route.stops.size(), i = option.i, j = option.j;
+        float bound = option.bound;
+        auto leg = [&](size_t k, NodeId a, NodeId b) {
+            float km = distance(a, b);
+            bound += km - option.legBounds[k];
+            return km;
+        };
+        float toPickup = leg(0, pointOf(route, i), pickup);
+        if (bound >= best.addedKm || plan.cum[i] + toPickup > pickupLimit) return;
+        float fromPickupKm = j == i ? 0.0f : leg(1, pickup, pointOf(route, i + 1));
+        if (bound >= best.addedKm) return;
+        float toDropoff = j == i ? tripKm : leg(2, pointOf(route, j), dropoff);
+        if (bound >= best.addedKm) return;
+        float fromDropoffKm = j < n ? leg(3, dropoff, pointOf(route, j + 1)) : 0.0f;
+        if (bound >= best.addedKm) return;
+        float shiftPickup, shiftDropoff, ride;
+        if (j == i) {
+            shiftPickup = toPickup + tripKm + fromDropoffKm - route.legKm[i];
+            shiftDropoff = 0.0f;
+            ride = tripKm;
+        } else {
+            shiftPickup = toPickup + fromPickupKm - route.legKm[i];
+            shiftDropoff = toDropoff + (j < n ? fromDropoffKm - route.legKm[j] : 0.0f);
+            ride = fromPickupKm + plan.cum[j] - plan.cum[i + 1] + toDropoff;
+        }
+        float added = shiftPickup + shiftDropoff;
+        if (added >= best.addedKm || ride > tripKm * (1.0f + POOL_MAX_DETOUR) || shiftPickup > plan.gapSlack[i]) return;
+        auto shifted = [&](size_t k) { return plan.cum[k] + (k > i ? shiftPickup : 0.0f) + (k > j ? shiftDropoff : 0.0f); };
+        bool feasible = all_of(plan.spans.begin(), plan.spans.end(), [&](const auto& span) {
+            auto [a, b, rider] = span;
+            if (rider->onboard) return shifted(b) + rider->ridden <= rider->rideLimit;
+            return shifted(a) <= rider->pickupLimit && shifted(b) - shifted(a) <= rider->rideLimit;
+        });
+        if (!feasible) return;
+        best.version = route.version;
+        best.pickupGap = i; best.dropoffGap = j;
+        best.addedKm = added; best.pickupKm = plan.cum[i] + toPickup;
+        best.toPickup = toPickup; best.fromPickup = fromPickupKm;
+        best.toDropoff = toDropoff; best.fromDropoff = fromDropoffKm;
+    }
+    static void advance(Route& route, Stop& reached, float& legKm, size_t& onboard) {
+        reached = route.stops.front();
+        legKm = route.legKm.front();
+        onboard = route.onboard;
+        for (auto& [id, rider] : route.riders) {
+            if (rider.onboard) rider.ridden += legKm;
+            else rider.pickupLimit -= legKm;
+        }
+        if (reached.pickup) { route.onboard++; route.riders[reached.rider].onboard = true; }
+        else { route.onboard--; route.riders.erase(reached.rider); }
+        route.stops.erase(route.stops.begin());
+        route.legKm.erase(route.legKm.begin());
+        route.position = reached.node;
+        route.version++;
+    }
+public:
+    static size_t seats(VehicleClass vehicle) { return vehicle == VehicleClass::FourSeater ? 4 : vehicle == VehicleClass::SevenSeater ? 7 : 1; }
+    void open(const string& driverPhone, VehicleClass vehicle, bool shareable, NodeId position, uint32_t rider,
+              NodeId pickup, NodeId dropoff, float pickupKm, float tripKm) {
+        lock_guard<mutex> lock(poolMutex);
+        Route& route = routes[driverPhone];
+        route = Route();
+        route.vehicle = vehicle;
+        route.seats = seats(vehicle);
+        route.shareable = shareable && route.seats > 1;
+        route.position = position;
+        route.stops = {{pickup, rider, true}, {dropoff, rider, false}};
+        route.legKm = {pickupKm, tripKm};
+        route.riders[rider] = {tripKm * (1.0f + POOL_MAX_DETOUR), 0.0f, pickupKm + POOL_PICKUP_SLACK_KM};
+    }
+    Insertion bestInsertion(Graph& cityMap, NodeId pickup, NodeId dropoff, VehicleClass vehicle, float tripKm, float pickupLimit = MAX_PICKUP_KM) const {
+        Insertion best;
+        deque<pair<string, Route>> candidates;
+        vector<Layout> plans;
+        vector<Option> options;
+        float rideLimit = tripKm * (1.0f + POOL_MAX_DETOUR);
+        {
+            lock_guard<mutex> lock(poolMutex);
+            for (const auto& [phone, route] : routes) {
+                if (!route.shareable || route.vehicle != vehicle || route.stops.size() < 2) continue;
+                size_t n = route.stops.size();
+                vector<float> toPickup(n + 1, INF);
+                bool nearby = false;
+                for (size_t i = 1; i < n; i++) {
+                    toPickup[i] = cityMap.distanceLowerBound(pointOf(route, i), pickup);
+                    nearby = nearby || toPickup[i] <= pickupLimit;
+                }
+                if (!nearby) continue;
+                // Layouts point into the copied riders, so candidates live in a deque that never moves them.
+                candidates.emplace_back(phone, route);
+                Layout plan = layout(candidates.back().second);
+                size_t before = options.size();
+                // Straight-line lower bounds on the added km order the exact checks and prune the rest.
+                for (size_t i = 1; i < n; i++) {
+                    if (plan.load[i] >= route.seats || plan.cum[i] + toPickup[i] > pickupLimit) continue;
+                    float fromPickup = cityMap.distanceLowerBound(pickup, pointOf(route, i + 1));
+                    float pickupShift = toPickup[i] + fromPickup - route.legKm[i];
+                    if (pickupShift > plan.gapSlack[i]) continue;
+                    float backToRoute = cityMap.distanceLowerBound(dropoff, pointOf(route, i + 1));
+                    float together = toPickup[i] + tripKm + backToRoute - route.legKm[i];
+                    if (together <= plan.gapSlack[i]) options.push_back({together, plans.size(), i, i, {toPickup[i], 0.0f, 0.0f, backToRoute}});
+                    for (size_t j = i + 1; j <= n; j++) {
+                        if (j < n && plan.load[j] + 1 > route.seats) break;
+                        float toDropoff = cityMap.distanceLowerBound(pointOf(route, j), dropoff);
+                        if (fromPickup + plan.cum[j] - plan.cum[i + 1] + toDropoff > rideLimit) break;
+                        float fromDropoff = j < n ? cityMap.distanceLowerBound(dropoff, pointOf(route, j + 1)) : 0.0f;
+                        float dropoffShift = toDropoff + fromDropoff - (j < n ? route.legKm[j] : 0.0f);
+                        options.push_back({pickupShift + dropoffShift, plans.size(), i, j, {toPickup[i], fromPickup, toDropoff, fromDropoff}});
+                    }
+                }
+                if (options.size() == before) { candidates.pop_back(); continue; }
+                plans.push_back(move(plan));
+            }
+        }
+        sort(options.begin(), options.end(), [](const Option& a, const Option& b) { return a.bound < b.bound; });
+        unordered_map<uint64_t, float> known;
+        auto distance = [&](NodeId a, NodeId b) {
+            uint64_t key = static_cast<uint64_t>(min(a, b)) << 32 | max(a, b);
+            auto it = known.find(key);
+            return it != known.end() ? it->second : known[key] = cityMap.shortestPath(a, b).first;
+        };
+        for (const Option& option : options) {
+            if (option.bound >= best.addedKm) break;
+            float previous = best.addedKm;
+            evaluate(candidates[option.candidate].second, plans[option.candidate], option, pickup, dropoff, tripKm, pickupLimit, distance, best);
+            if (best.addedKm < previous) best.driverPhone = candidates[option.candidate].first;
+        }
+        return best;
+    }
+    bool commit(const Insertion& insertion, uint32_t rider, NodeId pickup, NodeId dropoff, float tripKm) {
+        lock_guard<mutex> lock(poolMutex);
+        auto it = routes.find(insertion.driverPhone);
+        if (!insertion.found() || it == routes.end() || it->second.version != insertion.version) return false;
+        Route& route = it->second;
+        size_t i = insertion.pickupGap, j = insertion.dropoffGap;
+        if (j == i) {
+            route.stops.insert(route.stops.begin() + i, {{pickup, rider, true}, {dropoff, rider, false}});
+            route.legKm.insert(route.legKm.begin() + i, {insertion.toPickup, tripKm});
+            if (i + 2 < route.legKm.size()) route.legKm[i + 2] = insertion.fromDropoff;
+        } else {
+            route.stops.insert(route.stops.begin() + i, {pickup, rider, true});
+            route.legKm.insert(route.legKm.begin() + i, insertion.toPickup);
+            route.legKm[i + 1] = insertion.fromPickup;
+            route.stops.insert(route.stops.begin() + j + 1, {dropoff, rider, false});
+            route.legKm.insert(route.legKm.begin() + j + 1, insertion.toDropoff);
+            if (j + 2 < route.legKm.size()) route.legKm[j + 2] = insertion.fromDropoff;
+        }
+        route.riders[rider] = {tripKm * (1.0f + POOL_MAX_DETOUR), 0.0f, insertion.pickupKm + POOL_PICKUP_SLACK_KM};
+        route.version++;
+        return true;
+    }
+    bool nextStop(const string& driverPhone, Stop& next) const {
+        lock_guard<mutex> lock(poolMutex);
+        auto it = routes.find(driverPhone);
+        if (it == routes.end()) return false;
+        next = it->second.stops.front();
+        return true;
+    }
+    bool arrive(const string& driverPhone, Stop& reached, float& legKm, size_t& onboard) {
+        lock_guard<mutex> lock(poolMutex);
+        auto it = routes.find(driverPhone);
+        if (it == routes.end()) return false;
+        advance(it->second, reached, legKm, onboard);
+        if (it->second.stops.empty()) routes.erase(it);
+        return true;
+    }
+    bool finishRider(const string& driverPhone, uint32_t rider) {
+        lock_guard<mutex> lock(poolMutex);
+        auto it = routes.find(driverPhone);
+        if (it == routes.end()) return true;
+        Route& route = it->second;
+        Stop reached;
+        float legKm;
+        size_t onboard;
+        while (route.riders.count(rider) && !route.stops.empty()) advance(route, reached, legKm, onboard);
+        if (!route.stops.empty()) return false;
+        routes.erase(it);
+        return true;
+    }
+    bool removeRider(Graph& cityMap, const string& driverPhone, uint32_t rider) {
+        lock_guard<mutex> lock(poolMutex);
+        auto it = routes.find(driverPhone);
+        if (it == routes.end()) return true;
+        Route& route = it->second;
+        auto riderIt = route.riders.find(rider);
+        if (riderIt != route.riders.end() && riderIt->second.onboard) route.onboard--;
+        route.riders.erase(rider);
+        for (size_t k = route.stops.size(); k-- > 0;) {
+            if (route.stops[k].rider != rider) continue;
+            route.stops.erase(route.stops.begin() + k);
+            route.legKm.erase(route.legKm.begin() + k);
+            if (k < route.stops.size()) route.legKm[k] = cityMap.shortestPath(pointOf(route, k), route.stops[k].node).first;
+        }
+        route.version++;
+        if (!route.stops.empty()) return false;
+        routes.erase(it);
+        return true;
+    }
+    bool hasRoute(const string& driverPhone) const {
+        lock_guard<mutex> lock(poolMutex);
+        return routes.count(driverPhone) > 0;
+    }
+    size_t activeRoutes() const {
+        lock_guard<mutex> lock(poolMutex);
+        return routes.size();
+    }
+};
+
+enum class BookingStatus { Ok, UnknownRider, UnknownLocation, InvalidVehicle, NoRoute, NoDrivers, DriverUnavailable };
+
+struct BookingRequest {
+    string riderName, phone, source, destination, vehicleType, paymentMode;
+    bool shared = false;
+};
+
+struct DriverOffer {
+    Driver driver;
+    float pickupKm;
+    int etaMinutes;
+};
+
+struct RideQuote {
+    BookingStatus status = BookingStatus::Ok;
+    NodeId sourceId = INVALID_NODE, destinationId = INVALID_NODE;
+    float distance = INF, fare = 0.0f, surgeMultiplier = 1.0f, tripMinutes = INF;
+    vector<NodeId> route;
+    vector<DriverOffer> drivers;
+    bool pooled = false;
+    RidePool::Insertion insertion;
+};
+
+struct BookingResult {
+    BookingStatus status = BookingStatus::Ok;
+    string bookingID, otp, paymentMode;
+    DriverOffer assigned;
+    float fare = 0.0f;
+    bool paidFromWallet = false, shared = false;
+    uint32_t poolRider = 0;
+};
+
+class BookingEngine {
+private:
+    Graph& cityMap;
+    DriverManager& driverManager;
+    UserManager& userManager;
+    RideHistory& rideHistory;
+    RatingSystem& ratingSystem;
+    RidePool pool;
+    atomic<uint32_t> nextPoolRider{1};
+    static mt19937& rng() {
+        thread_local mt19937 generator{random_device{}()};
+        return generator;
+    }
+public:
+    BookingEngine(Graph& map, DriverManager& dm, UserManager& um, RideHistory& rh, RatingSystem& rs)
+        : cityMap(map), driverManager(dm), userManager(um), rideHistory(rh), ratingSystem(rs) {}
+    static float baseRate(VehicleClass vehicle) {
+        static const array<float, VEHICLE_CLASSES> rates = {10.0f, 15.0f, 20.0f};
+        return vehicle < VehicleClass::Count ? rates[static_cast<size_t>(vehicle)] : 0.0f;
+    }
+    string generateOTP() { return to_string(uniform_int_distribution<>(1000, 9999)(rng())); }
+    vector<DriverOffer> nearestDrivers(VehicleClass vehicle, NodeId sourceId, time_t when = time(0)) {
+        ScopedTimer timer(Metric::DriverCandidates);
+        vector<DriverOffer> offers;
+        for (auto& [driver, driverDist] : driverManager.nearestAvailable(vehicle, sourceId, 2 * DRIVER_CANDIDATES, MAX_PICKUP_KM)) {
+            offers.push_back({driver, driverDist, etaMinutes(driverDist)});
+        }
+        Metrics::add(Counter::CandidatesScanned, offers.size());
+        rankByEta(cityMap, sourceId, offers, when);
+        return offers;
+    }
+    static void rankByEta(Graph& cityMap, NodeId sourceId, vector<DriverOffer>& offers, time_t when) {
+        vector<NodeId> driverNodes;
+        for (const auto& offer : offers) driverNodes.push_back(offer.driver.node);
+        vector<float> minutes = cityMap.travelMinutesTo(sourceId, driverNodes, when);
+        for (size_t i = 0; i < offers.size(); i++) {
+            if (minutes[i] < INF) offers[i].etaMinutes = max(1, static_cast<int>(ceil(minutes[i])));
+        }
+        stable_sort(offers.begin(), offers.end(), [](const DriverOffer& a, const DriverOffer& b) { return a.etaMinutes < b.etaMinutes; });
+        if (offers.size() > DRIVER_CANDIDATES) offers.resize(DRIVER_CANDIDATES);
     }
-    void addRating(const string& driverPhone, float rating) {
-        if (rating < 1 || rating > 5) return;
-        auto& [total, count] = driverRatings[driverPhone];
-        total += rating;
-        count++;
+    static int etaMinutes(float pickupKm) { return max(1, static_cast<int>(pickupKm * 3)); }
+    static bool shareable(const BookingRequest& request) { return request.shared && RidePool::seats(vehicleClassOf(request.vehicleType)) > 1; }
+    RidePool& ridePool() { return pool; }
+    // A shared rider waits at most a little longer than the nearest free driver would take, and only joins a route that adds fewer km than a solo trip.
+    static float poolPickupLimit(const vector<DriverOffer>& offers) {
+        return offers.empty() ? MAX_PICKUP_KM : min(MAX_PICKUP_KM, offers.front().pickupKm + POOL_PICKUP_SLACK_KM);
     }
-    float getAverageRating(const string& driverPhone) {
-        if (!driverRatings.count(driverPhone)) return 0.0f;
-        auto [total, count] = driverRatings[driverPhone];
-        return count > 0 ? total / count : 0.0f;
+    static bool preferPooled(const RidePool::Insertion& insertion, const vector<DriverOffer>& offers, float tripKm) {
+        return insertion.found() && (offers.empty() || insertion.addedKm < offers.front().pickupKm + tripKm);
     }
-    void saveRatings() {
-        ofstream fout(DRIVER_RATINGS);
-        if (!fout.is_open()) {
-            cerr << "Error: Could not open " << DRIVER_RATINGS << " for writing.\n";
-            return;
+    RideQuote price(const BookingRequest& request, time_t when = time(0), bool newRequest = true) {
+        RideQuote quote;
+        quote.sourceId = cityMap.findLocation(request.source);
+        quote.destinationId = cityMap.findLocation(request.destination);
+        if (quote.sourceId == INVALID_NODE || quote.destinationId == INVALID_NODE) { quote.status = BookingStatus::UnknownLocation; return quote; }
+        VehicleClass vehicle = vehicleClassOf(request.vehicleType);
+        if (vehicle == VehicleClass::Count) { quote.status = BookingStatus::InvalidVehicle; return quote; }
+        float rate = baseRate(vehicle);
+        SurgeEngine& surge = driverManager.surgePricing();
+        if (newRequest) surge.recordRequest(quote.sourceId, vehicle, when);
+        tie(quote.distance, quote.route) = cityMap.shortestPath(quote.sourceId, quote.destinationId);
+        if (quote.route.empty()) { quote.status = BookingStatus::NoRoute; return quote; }
+        quote.surgeMultiplier = surge.multiplier(quote.sourceId, vehicle, when);
+        quote.fare = rate * quote.distance * quote.surgeMultiplier * (shareable(request) ? POOL_FARE_FACTOR : 1.0f);
+        quote.tripMinutes = cityMap.routeMinutes(quote.route, when);
+        return quote;
+    }
+    RideQuote quote(const BookingRequest& request, time_t when = time(0), bool newRequest = true) {
+        RideQuote quote = price(request, when, newRequest);
+        if (quote.status != BookingStatus::Ok) return quote;
+        VehicleClass vehicle = vehicleClassOf(request.vehicleType);
+        quote.drivers = nearestDrivers(vehicle, quote.sourceId, when);
+        if (shareable(request)) {
+            ScopedTimer timer(Metric::PoolInsertion);
+            quote.insertion = pool.bestInsertion(cityMap, quote.sourceId, quote.destinationId, vehicle, quote.distance, poolPickupLimit(quote.drivers));
+            Driver driver;
+            if (preferPooled(quote.insertion, quote.drivers, quote.distance) && driverManager.getDriver(quote.insertion.driverPhone, driver)) {
+                quote.pooled = true;
+                quote.drivers = {{driver, quote.insertion.pickupKm, etaMinutes(quote.insertion.pickupKm)}};
+            }
         }
-        for (const auto& [phone, ratingData] : driverRatings) {
-            fout << phone << "," << ratingData.first << "," << ratingData.second << "\n";
+        if (quote.drivers.empty()) quote.status = BookingStatus::NoDrivers;
+        return quote;
+    }
+    BookingResult confirm(const BookingRequest& request, const RideQuote& quote, size_t choice = 0) {
+        BookingResult result;
+        UserAccount user;
+        if (!userManager.getUser(request.phone, user)) { result.status = BookingStatus::UnknownRider; return result; }
+        if (quote.status != BookingStatus::Ok || choice >= quote.drivers.size()) { result.status = quote.status == BookingStatus::Ok ? BookingStatus::NoDrivers : quote.status; return result; }
+        result.assigned = quote.drivers[choice];
+        result.shared = shareable(request);
+        if (result.shared) result.poolRider = nextPoolRider++;
+        if (quote.pooled) {
+            if (!pool.commit(quote.insertion, result.poolRider, quote.sourceId, quote.destinationId, quote.distance)) { result.status = BookingStatus::DriverUnavailable; return result; }
+        } else {
+            if (!driverManager.reserveDriver(result.assigned.driver.phone)) { result.status = BookingStatus::DriverUnavailable; return result; }
+            if (result.shared) {
+                pool.open(result.assigned.driver.phone, result.assigned.driver.vehicleClass, true, result.assigned.driver.node, result.poolRider,
+                          quote.sourceId, quote.destinationId, result.assigned.pickupKm, quote.distance);
+            }
         }
-        fout.close();
+        result.fare = quote.fare;
+        result.paymentMode = request.paymentMode.empty() ? user.getPaymentMethod() : request.paymentMode;
+        result.paidFromWallet = result.paymentMode == "Wallet" && userManager.chargeWallet(request.phone, result.fare);
+        result.bookingID = rideHistory.nextBookingID();
+        result.otp = generateOTP();
+        return result;
     }
-    void displayDriverRating(const string& driverPhone) {
-        float rating = getAverageRating(driverPhone);
-        cout << "Driver Rating: ";
-        if (rating == 0) cout << "No ratings yet\n";
-        else cout << fixed << setprecision(1) << rating << "/5 (" << string(static_cast<int>(round(rating)), '*') << ")\n";
+    void cancel(const BookingRequest& request, const BookingResult& result) {
+        if (result.status != BookingStatus::Ok) return;
+        if (result.paidFromWallet) userManager.creditWallet(request.phone, result.fare);
+        if (result.shared && !pool.removeRider(cityMap, result.assigned.driver.phone, result.poolRider)) return;
+        driverManager.releaseDriver(result.assigned.driver.phone);
     }
-};
-
-class UserAccount {
-private:
-    string username, phone, email, paymentMethod;
-    float walletBalance;
-public:
-    UserAccount(const string& uname, const string& ph, const string& em, const string& pm, float bal)
-        : username(uname), phone(ph), email(em), paymentMethod(pm), walletBalance(bal) {}
-    void displayProfile() const {
-        cout << "\n=== User Profile ===\nName: " << username << "\nPhone: " << phone 
-             << "\nEmail: " << (email.empty() ? "Not provided" : email)
-             << "\nPayment Method: " << paymentMethod << "\nWallet Balance: RS " 
-             << fixed << setprecision(2) << walletBalance << "\n";
+    BookingResult dispatch(const BookingRequest& request, bool newRequest = true) {
+        BookingRequest attempt = request;
+        for (size_t round = 0;; round++) {
+            // A route that keeps changing under us is given up on and the rider gets a solo ride instead.
+            if (round == POOL_DISPATCH_ATTEMPTS) attempt.shared = false;
+            RideQuote offer = quote(attempt, time(0), newRequest && round == 0);
+            BookingResult result;
+            result.status = offer.status;
+            for (size_t choice = 0; choice < offer.drivers.size(); choice++) {
+                result = confirm(attempt, offer, choice);
+                if (result.status != BookingStatus::DriverUnavailable) break;
+            }
+            if (!offer.pooled || result.status != BookingStatus::DriverUnavailable) return result;
+        }
     }
-    bool makePayment(float amount) {
-        if (walletBalance >= amount) { walletBalance -= amount; return true; }
-        return false;
+    void complete(const BookingRequest& request, const BookingResult& result) {
+        if (result.status != BookingStatus::Ok) return;
+        rideHistory.logRide(result.bookingID, request.riderName, request.phone, request.source, request.destination,
+                            request.vehicleType, result.fare, result.assigned.driver);
+        if (result.shared && !pool.finishRider(result.assigned.driver.phone, result.poolRider)) return;
+        driverManager.relocateDriver(result.assigned.driver.phone, request.destination);
+        driverManager.releaseDriver(result.assigned.driver.phone);
     }
-    void addToWallet(float amount) { walletBalance += amount; }
-    float getBalance() const { return walletBalance; }
-    string getPaymentMethod() const { return paymentMethod; }
-    void updatePaymentMethod(const string& newMethod) { paymentMethod = newMethod; }
-    void saveToFile(ofstream& fout) const {
-        fout << username << "," << phone << "," << email << ","
-             << paymentMethod << "," << walletBalance << "\n";
+    bool rate(const string& bookingID, float rating) {
+        if (rating < 1 || rating > 5 || !rideHistory.addRating(bookingID, rating, ratingSystem)) return false;
+        ratingSystem.saveRatings();
+        return true;
     }
 };
 
-class UserManager {
+class DispatchPool {
 private:
-    unordered_map<string, UserAccount> users;
-public:
-    UserManager() { loadUsers(); }
-    void loadUsers() {
-        ifstream fin(USER_ACCOUNTS);
-        if (!fin.is_open()) return;
-        string line;
-        while (getline(fin, line)) {
-            stringstream ss(line);
-            string username, phone, email, paymentMethod, balanceStr;
-            getline(ss, username, ',');
-            getline(ss, phone, ',');
-            getline(ss, email, ',');
-            getline(ss, paymentMethod, ',');
-            getline(ss, balanceStr, ',');
-            try {
-                users.emplace(phone, UserAccount(username, phone, email, paymentMethod, stof(balanceStr)));
-            } catch (...) { continue; }
-        }
-        fin.close();
-    }
-    bool userExists(const string& phone) const { return users.count(phone) > 0; }
-    UserAccount* getUser(const string& phone) { return users.count(phone) ? &users.at(phone) : nullptr; }
-    void createUser(const string& username, const string& phone) {
-        if (userExists(phone)) { cout << "User already exists!\n"; return; }
-        string email, paymentMethod;
-        cout << "Enter email (optional): "; getline(cin, email);
+    typedef packaged_task<BookingResult()> Job;
+    BookingEngine& engine;
+    vector<thread> workers;
+    deque<Job> jobs;
+    mutex jobsMutex;
+    condition_variable jobReady;
+    bool stopping = false;
+    void run() {
         while (true) {
-            cout << "Enter payment method (Cash/Wallet): "; getline(cin, paymentMethod);
-            if (normalize(paymentMethod) == "cash" || normalize(paymentMethod) == "wallet") break;
-            cout << "Invalid payment method! Please choose Cash or Wallet.\n";
+            Job job;
+            {
+                unique_lock<mutex> lock(jobsMutex);
+                jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (jobs.empty()) return;
+                job = move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
         }
-        paymentMethod = normalize(paymentMethod) == "cash" ? "Cash" : "Wallet";
-        users.emplace(phone, UserAccount(username, phone, email, paymentMethod, 0.0f));
-        saveUsers();
-        cout << "Account created successfully!\n";
     }
-    void saveUsers() {
-        ofstream fout(USER_ACCOUNTS);
-        if (!fout.is_open()) {
-            cerr << "Error: Could not open " << USER_ACCOUNTS << " for writing.\n";
-            return;
+public:
+    DispatchPool(BookingEngine& bookingEngine, size_t threads) : engine(bookingEngine) {
+        for (size_t i = 0; i < max(threads, size_t(1)); i++) workers.emplace_back([this] { run(); });
+    }
+    ~DispatchPool() {
+        {
+            lock_guard<mutex> lock(jobsMutex);
+            stopping = true;
         }
-        for (const auto& [phone, account] : users) account.saveToFile(fout);
-        fout.close();
+        jobReady.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+    future<BookingResult> submit(const BookingRequest& request) {
+        return submit([this, request] { return engine.dispatch(request); });
+    }
+    template <typename Task>
+    future<BookingResult> submit(Task task) {
+        Job job(move(task));
+        future<BookingResult> result = job.get_future();
+        {
+            lock_guard<mutex> lock(jobsMutex);
+            jobs.push_back(move(job));
+        }
+        jobReady.notify_one();
+        return result;
     }
-    size_t getUserCount() const { return users.size(); }
+    size_t workerCount() const { return workers.size(); }
 };
 
-class Driver {
-public:
-    string name, phone, location, vehicleType;
-    bool available;
-    Driver(const string& n, const string& p, const string& loc, const string& vt, bool avail = true)
-        : name(n), phone(p), location(loc), vehicleType(vt), available(avail) {}
-    void displayInfo() const {
-        cout << "\n=== Driver Information ===\nName: " << name << "\nPhone: " << phone
-             << "\nLocation: " << location << "\nVehicle: " << vehicleType 
-             << "\nStatus: " << (available ? "Available" : "On Ride") << "\n";
+vector<int> minCostAssignment(const vector<vector<float>>& cost) {
+    size_t rows = cost.size(), cols = rows ? cost[0].size() : 0;
+    vector<int> assignment(rows, -1);
+    if (rows == 0 || cols == 0) return assignment;
+    bool transposed = rows > cols;
+    size_t n = transposed ? cols : rows, m = transposed ? rows : cols;
+    auto at = [&](size_t i, size_t j) -> double { return transposed ? cost[j][i] : cost[i][j]; };
+    vector<double> u(n + 1, 0.0), v(m + 1, 0.0), minv(m + 1);
+    vector<size_t> match(m + 1, 0), way(m + 1, 0);
+    vector<char> used(m + 1);
+    for (size_t i = 1; i <= n; i++) {
+        match[0] = i;
+        size_t j0 = 0;
+        fill(minv.begin(), minv.end(), numeric_limits<double>::infinity());
+        fill(used.begin(), used.end(), 0);
+        do {
+            used[j0] = 1;
+            size_t i0 = match[j0], j1 = 0;
+            double delta = numeric_limits<double>::infinity();
+            for (size_t j = 1; j <= m; j++) {
+                if (used[j]) continue;
+                double reduced = at(i0 - 1, j - 1) - u[i0] - v[j];
+                if (reduced < minv[j]) { minv[j] = reduced; way[j] = j0; }
+                if (minv[j] < delta) { delta = minv[j]; j1 = j; }
+            }
+            for (size_t j = 0; j <= m; j++) {
+                if (used[j]) { u[match[j]] += delta; v[j] -= delta; }
+                else minv[j] -= delta;
+            }
+            j0 = j1;
+        } while (match[j0] != 0);
+        do {
+            size_t j1 = way[j0];
+            match[j0] = match[j1];
+            j0 = j1;
+        } while (j0);
+    }
+    for (size_t j = 1; j <= m; j++) {
+        if (!match[j]) continue;
+        if (transposed) assignment[j - 1] = static_cast<int>(match[j] - 1);
+        else assignment[match[j] - 1] = static_cast<int>(j - 1);
     }
-    void toggleAvailability() { available = !available; }
-    void saveToFile(ofstream& fout) const {
-        fout << name << "," << phone << "," << location << ","
-             << vehicleType << "," << available << "\n";
+    return assignment;
+}
+
+struct BatchReport {
+    size_t riders = 0, matched = 0, greedyMatched = 0;
+    float pickupKm = 0.0f, greedyPickupKm = 0.0f;
+    double solveMs = 0.0;
+    void add(const BatchReport& other) {
+        riders += other.riders; matched += other.matched; greedyMatched += other.greedyMatched;
+        pickupKm += other.pickupKm; greedyPickupKm += other.greedyPickupKm; solveMs += other.solveMs;
     }
 };
 
-class DriverManager {
+class BatchDispatcher {
 private:
-    vector<Driver> drivers;
-public:
-    DriverManager() { loadDrivers(); }
-    void loadDrivers() {
-        drivers.clear();
-        ifstream fin(DRIVERS_FILE);
-        if (!fin.is_open() || fin.peek() == ifstream::traits_type::eof()) {
-            cout << "No driver file found or empty. Initializing default drivers...\n";
-            drivers = {
-                Driver("Ramesh", "9990010001", "Connaught Place", "2-wheeler", true),
-                Driver("Neha", "9990051112", "Lajpat Nagar", "2-wheeler", true),
-                Driver("Anil", "9991012223", "RK Puram", "4-seater", true),
-                Driver("Sita", "9992023334", "Saket", "7-seater", true),
-                Driver("Aman", "9993034445", "Jasola", "4-seater", true),
-                Driver("Priya", "9994045556", "Tilak Nagar", "2-wheeler", true),
-                Driver("Deepak", "9995056667", "Dwarka", "4-seater", true),
-                Driver("Komal", "9996067778", "Janakpuri", "2-wheeler", true),
-                Driver("Manoj", "9997078889", "Karol Bagh", "7-seater", true),
-                Driver("Tina", "9998089990", "Green Park", "2-wheeler", true),
-                Driver("Rahul", "9999099999", "Saket", "4-seater", true),
-                Driver("Vikram", "9999098888", "Saket", "7-seater", true),
-                Driver("Sunita", "9999097777", "Lajpat Nagar", "7-seater", true)
-            };
-            saveDrivers();
-            cout << "Initialized " << drivers.size() << " default drivers.\n";
-            return;
-        }
-        string line;
-        int lineNum = 0;
-        cout << "Loading drivers from " << DRIVERS_FILE << ":\n";
-        while (getline(fin, line)) {
-            lineNum++;
-            stringstream ss(line);
-            string name, phone, location, vehicleType, availStr;
-            getline(ss, name, ',');
-            getline(ss, phone, ',');
-            getline(ss, location, ',');
-            getline(ss, vehicleType, ',');
-            getline(ss, availStr, ',');
-            if (name.empty() || phone.empty() || location.empty() || vehicleType.empty()) {
-                cout << "Warning: Skipping invalid line " << lineNum << ": " << line << "\n";
-                continue;
+    struct Pending {
+        BookingRequest request;
+        promise<BookingResult> result;
+    };
+    static constexpr float UNREACHABLE = 1e6f;
+    BookingEngine& engine;
+    DriverManager& driverManager;
+    Graph& cityMap;
+    chrono::milliseconds window;
+    bool recordDemand;
+    vector<Pending> pending;
+    mutex pendingMutex, reportMutex;
+    condition_variable wake;
+    bool stopping = false;
+    BatchReport totals;
+    thread worker;
+    void run() {
+        while (true) {
+            vector<Pending> batch;
+            {
+                unique_lock<mutex> lock(pendingMutex);
+                wake.wait_for(lock, window, [this] { return stopping; });
+                batch.swap(pending);
+                if (batch.empty() && stopping) return;
             }
-            bool available = (availStr == "1" || availStr == "true");
-            drivers.emplace_back(name, phone, location, vehicleType, available);
-            cout << "Loaded driver: " << name << ", " << phone << ", " << vehicleType << "\n";
-        }
-        fin.close();
-        bool hasTwoWheeler = false, hasSevenSeaterSaket = false;
-        for (const auto& driver : drivers) {
-            if (driver.vehicleType == "2-wheeler" && driver.available) hasTwoWheeler = true;
-            if (driver.vehicleType == "7-seater" && normalize(driver.location) == "saket" && driver.available) hasSevenSeaterSaket = true;
-        }
-        if (!hasTwoWheeler) {
-            drivers.emplace_back("Ramesh", "9990010001", "Connaught Place", "2-wheeler", true);
-            cout << "Added 2-wheeler driver.\n";
-        }
-        if (!hasSevenSeaterSaket) {
-            drivers.emplace_back("Vikram", "9999098888", "Saket", "7-seater", true);
-            cout << "Added 7-seater driver at Saket.\n";
+            if (batch.empty()) continue;
+            vector<BookingRequest> requests;
+            for (const auto& entry : batch) requests.push_back(entry.request);
+            vector<BookingResult> results;
+            BatchReport report = match(requests, results);
+            {
+                lock_guard<mutex> lock(reportMutex);
+                totals.add(report);
+            }
+            for (size_t i = 0; i < batch.size(); i++) batch[i].result.set_value(results[i]);
         }
-        saveDrivers();
-        cout << "Loaded " << drivers.size() << " drivers.\n";
     }
-    void registerNewDriver() {
-        string name, phone, location, vehicle;
-        cout << "Enter your name: "; getline(cin, name);
-        while (true) {
-            cout << "Phone number (10 digits): "; getline(cin, phone);
-            if (phone.length() == 10 && all_of(phone.begin(), phone.end(), ::isdigit)) break;
-            cout << "Invalid number! Try again.\n";
+public:
+    // Synthetic batches pass recordDemand = false so they do not raise live surge for real riders.
+    BatchDispatcher(BookingEngine& bookingEngine, DriverManager& dm, Graph& map, chrono::milliseconds batchWindow = BATCH_WINDOW,
+                    bool countDemand = true)
+        : engine(bookingEngine), driverManager(dm), cityMap(map), window(batchWindow), recordDemand(countDemand) {
+        worker = thread([this] { run(); });
+    }
+    ~BatchDispatcher() {
+        {
+            lock_guard<mutex> lock(pendingMutex);
+            stopping = true;
         }
-        cout << "Enter your current location: "; getline(cin, location);
-        cout << "Select vehicle (1 = 2-wheeler, 2 = 4-seater, 3 = 7-seater): ";
-        int choice; cin >> choice; cin.ignore();
-        if (choice == 1) vehicle = "2-wheeler";
-        else if (choice == 2) vehicle = "4-seater";
-        else if (choice == 3) vehicle = "7-seater";
-        else { cout << "Invalid choice. Registration failed.\n"; return; }
-        drivers.emplace_back(name, phone, location, vehicle);
-        saveDrivers();
-        cout << "Driver registered successfully!\n";
+        wake.notify_all();
+        worker.join();
     }
-    void saveDrivers() {
-        ofstream fout(DRIVERS_FILE);
-        if (!fout.is_open()) {
-            cerr << "Error: Could not open " << DRIVERS_FILE << " for writing.\n";
-            return;
+    future<BookingResult> submit(const BookingRequest& request) {
+        lock_guard<mutex> lock(pendingMutex);
+        pending.push_back({request, {}});
+        return pending.back().result.get_future();
+    }
+    BatchReport getTotals() {
+        lock_guard<mutex> lock(reportMutex);
+        return totals;
+    }
+    BatchReport match(const vector<BookingRequest>& requests, vector<BookingResult>& results) {
+        BatchReport report;
+        report.riders = requests.size();
+        results.assign(requests.size(), BookingResult());
+        vector<RideQuote> quotes(requests.size());
+        map<VehicleClass, vector<size_t>> byVehicle;
+        for (size_t i = 0; i < requests.size(); i++) {
+            quotes[i] = engine.price(requests[i], time(0), recordDemand);
+            if (quotes[i].status == BookingStatus::Ok) byVehicle[vehicleClassOf(requests[i].vehicleType)].push_back(i);
+            else results[i].status = quotes[i].status;
         }
-        int count = 0;
-        for (const auto& driver : drivers) {
-            if (!driver.name.empty() && !driver.phone.empty()) {
-                driver.saveToFile(fout);
-                count++;
+        for (const auto& [vehicle, requested] : byVehicle) {
+            // Some optimal assignment only uses each rider's n nearest drivers, n being the riders in the class, so the
+            // columns are the union of per-rider searches; past BATCH_CANDIDATES riders this trades exactness for speed.
+            vector<Driver> fleet;
+            unordered_map<string, size_t> column;
+            vector<size_t> riders;
+            vector<vector<pair<size_t, float>>> reach;
+            for (size_t slot : requested) {
+                auto nearby = driverManager.nearestAvailable(vehicle, quotes[slot].sourceId, min(requested.size(), BATCH_CANDIDATES), MAX_PICKUP_KM);
+                if (nearby.empty()) { results[slot].status = BookingStatus::NoDrivers; continue; }
+                riders.push_back(slot);
+                reach.emplace_back();
+                for (auto& [driver, dist] : nearby) {
+                    auto [it, added] = column.emplace(driver.phone, fleet.size());
+                    if (added) fleet.push_back(move(driver));
+                    reach.back().emplace_back(it->second, dist);
+                }
             }
-        }
-        fout.close();
-        cout << "Saved " << count << " drivers to " << DRIVERS_FILE << ".\n";
-    }
-    vector<Driver> getAllDrivers() const { return drivers; }
-    void toggleDriverAvailability(const string& phone) {
-        for (auto& driver : drivers) {
-            if (driver.phone == phone) {
-                driver.toggleAvailability();
-                saveDrivers();
-                cout << "Availability updated to: " << (driver.available ? "Available" : "On Ride") << "\n";
-                return;
+            if (riders.empty()) continue;
+            vector<vector<float>> pickup(riders.size(), vector<float>(fleet.size(), INF));
+            for (size_t r = 0; r < riders.size(); r++) for (auto [d, dist] : reach[r]) pickup[r][d] = dist;
+            vector<char> taken(fleet.size(), 0);
+            for (size_t r = 0; r < riders.size(); r++) {
+                size_t best = fleet.size();
+                for (size_t d = 0; d < fleet.size(); d++) {
+                    if (!taken[d] && pickup[r][d] != INF && (best == fleet.size() || pickup[r][d] < pickup[r][best])) best = d;
+                }
+                if (best == fleet.size()) continue;
+                taken[best] = 1;
+                report.greedyMatched++;
+                report.greedyPickupKm += pickup[r][best];
+            }
+            vector<vector<float>> cost = pickup;
+            for (auto& row : cost) for (auto& value : row) if (value == INF) value = UNREACHABLE;
+            auto start = chrono::steady_clock::now();
+            vector<int> assignment = minCostAssignment(cost);
+            report.solveMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            for (size_t r = 0; r < riders.size(); r++) {
+                size_t slot = riders[r];
+                int d = assignment[r];
+                if (d < 0 || pickup[r][d] == INF) { results[slot].status = BookingStatus::NoDrivers; continue; }
+                quotes[slot].drivers = {{fleet[d], pickup[r][d], BookingEngine::etaMinutes(pickup[r][d])}};
+                results[slot] = engine.confirm(requests[slot], quotes[slot]);
+                if (results[slot].status == BookingStatus::DriverUnavailable) results[slot] = engine.dispatch(requests[slot], false);
+                if (results[slot].status != BookingStatus::Ok) continue;
+                report.matched++;
+                report.pickupKm += results[slot].assigned.pickupKm;
             }
         }
-        cout << "Driver not found!\n";
+        return report;
     }
-    size_t getDriverCount() const { return drivers.size(); }
 };
 
-class Graph {
+class TrafficFeed {
+public:
+    struct Stats { size_t batches = 0, lastEdges = 0; double lastMillis = 0.0; };
 private:
-    map<string, vector<pair<string, float>>> adj;
-    map<string, pair<float, float>> locationCoords;
-public:
-    void addEdge(const string& from, const string& to, float distance) {
-        string a = normalize(from), b = normalize(to);
-        adj[a].emplace_back(b, distance);
-        adj[b].emplace_back(a, distance);
-    }
-    void addLocation(const string& location, float lat, float lon) {
-        locationCoords[normalize(location)] = {lat, lon};
-    }
-    float haversineDistance(const string& loc1, const string& loc2) {
-        string l1 = normalize(loc1), l2 = normalize(loc2);
-        if (!locationCoords.count(l1) || !locationCoords.count(l2)) return INF;
-        auto [lat1, lon1] = locationCoords[l1];
-        auto [lat2, lon2] = locationCoords[l2];
-        lat1 *= PI / 180.0; lon1 *= PI / 180.0;
-        lat2 *= PI / 180.0; lon2 *= PI / 180.0;
-        float dlat = lat2 - lat1, dlon = lon2 - lon1;
-        float a = pow(sin(dlat / 2), 2) + cos(lat1) * cos(lat2) * pow(sin(dlon / 2), 2);
-        return 6371 * 2 * atan2(sqrt(a), sqrt(1 - a));
-    }
-    pair<float, vector<string>> shortestPath(const string& src, const string& dest) {
-        string s = normalize(src), d = normalize(dest);
-        if (!adj.count(s) || !adj.count(d)) return {INF, {}};
-        map<string, float> dist;
-        map<string, string> parent;
-        set<string> visited;
-        for (const auto& [node, _] : adj) dist[node] = INF;
-        dist[s] = 0.0;
-        priority_queue<pair<float, string>, vector<pair<float, string>>, greater<>> pq;
-        pq.push({0.0, s});
-        while (!pq.empty()) {
-            auto [currDist, u] = pq.top(); pq.pop();
-            if (visited.count(u)) continue;
-            visited.insert(u);
-            for (auto [v, weight] : adj[u]) {
-                if (dist[v] > dist[u] + weight) {
-                    dist[v] = dist[u] + weight;
-                    parent[v] = u;
-                    pq.push({dist[v], v});
-                }
+    Graph& cityMap;
+    string path;
+    time_t lastModified = 0;
+    off_t lastSize = -1;
+    bool recheck = false;
+    Stats stats;
+    mutable mutex statsMutex;
+    condition_variable wake;
+    bool stopping = false;
+    thread poller;
+public:
+    TrafficFeed(Graph& map, const string& updatesPath, chrono::seconds interval) : cityMap(map), path(updatesPath) {
+        poll();
+        poller = thread([this, interval] {
+            unique_lock<mutex> lock(statsMutex);
+            while (!wake.wait_for(lock, interval, [this] { return stopping; })) {
+                lock.unlock();
+                poll();
+                lock.lock();
             }
+        });
+    }
+    ~TrafficFeed() {
+        {
+            lock_guard<mutex> lock(statsMutex);
+            stopping = true;
         }
-        if (dist[d] == INF) return {INF, {}};
-        vector<string> path;
-        for (string at = d; at != s; at = parent[at]) path.push_back(at);
-        path.push_back(s);
-        reverse(path.begin(), path.end());
-        return {dist[d], path};
+        wake.notify_all();
+        poller.join();
+    }
+    size_t poll() {
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0) return 0;
+        if (info.st_mtime == lastModified && info.st_size == lastSize && !recheck) return 0;
+        // mtime has one-second granularity, so a stamp from the current second is read again on the next poll.
+        lastModified = info.st_mtime;
+        lastSize = info.st_size;
+        recheck = info.st_mtime >= time(0);
+        auto start = chrono::steady_clock::now();
+        size_t applied = cityMap.applyTrafficUpdates(path, time(0));
+        lock_guard<mutex> lock(statsMutex);
+        stats.batches++;
+        stats.lastEdges = applied;
+        stats.lastMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return applied;
+    }
+    Stats getStats() const {
+        lock_guard<mutex> lock(statsMutex);
+        return stats;
     }
-    bool locationExists(const string& location) const { return adj.count(normalize(location)) > 0; }
 };
 
-class RideHistory {
-public:
-    struct RideRecord {
-        string bookingID, user, userPhone, source, destination, vehicleType;
-        float fare;
-        string driverName, driverPhone, timestamp;
-        float rating;
+struct SimulationReport {
+    size_t requests = 0, served = 0, pooled = 0, abandoned = 0, unroutable = 0, queued = 0, events = 0, drivers = 0, peakBusy = 0;
+    double pickupKm = 0.0, tripKm = 0.0, vehicleKm = 0.0, emptyKm = 0.0, tripMinutes = 0.0, busyMinutes = 0.0, revenue = 0.0, surgeTotal = 0.0;
+    int64_t simulatedSeconds = 0;
+    double wallMs = 0.0;
+    vector<float> waitMinutes;
+    float waitPercentile(double p) const {
+        if (waitMinutes.empty()) return 0.0f;
+        size_t rank = static_cast<size_t>(ceil(p / 100.0 * waitMinutes.size()));
+        return waitMinutes[min(waitMinutes.size(), max(rank, size_t(1))) - 1];
+    }
+};
+
+class FleetSimulator {
+private:
+    // Arrivals sort first so a driver freed at second t can take a request made at second t.
+    enum class EventType { Arrive, Request, Abandon };
+    struct Event {
+        int64_t at;
+        EventType type;
+        uint32_t id;
+        bool operator>(const Event& other) const { return tie(at, type, id) > tie(other.at, other.type, other.id); }
     };
-    vector<RideRecord> records;
-    void loadHistory() {
-        ifstream fin(RIDE_HISTORY);
-        if (!fin.is_open()) return;
-        string line; getline(fin, line);
-        while (getline(fin, line)) {
-            stringstream ss(line);
-            RideRecord record;
-            string fareStr, ratingStr;
-            getline(ss, record.bookingID, ',');
-            getline(ss, record.user, ',');
-            getline(ss, record.userPhone, ',');
-            getline(ss, record.source, ',');
-            getline(ss, record.destination, ',');
-            getline(ss, record.vehicleType, ',');
-            getline(ss, fareStr, ',');
-            getline(ss, record.driverName, ',');
-            getline(ss, record.driverPhone, ',');
-            getline(ss, record.timestamp, ',');
-            getline(ss, ratingStr, ',');
-            try {
-                record.fare = stof(fareStr);
-                record.rating = ratingStr.empty() ? 0.0f : stof(ratingStr);
-                records.push_back(record);
-            } catch (...) { continue; }
-        }
-        fin.close();
-    }
-    void displayUserHistory(const string& userPhone) {
-        cout << "\n=== Your Ride History ===\n";
-        bool found = false;
-        for (const auto& record : records) {
-            if (record.userPhone == userPhone) {
-                found = true;
-                cout << "Booking ID: " << record.bookingID << "\nFrom: " << record.source 
-                     << " To: " << record.destination << "\nVehicle: " << record.vehicleType
-                     << "\nDriver: " << record.driverName << " (" << record.driverPhone << ")\n"
-                     << "Fare: RS " << fixed << setprecision(2) << record.fare << "\nDate: " 
-                     << record.timestamp << "\nRating: " << (record.rating > 0 ? to_string(record.rating)+"/5" : "Not rated") << "\n------------------------\n";
-            }
-        }
-        if (!found) cout << "No ride history found.\n";
-    }
-    void addRating(const string& bookingID, float rating, RatingSystem& ratingSystem) {
-        for (auto& record : records) {
-            if (record.bookingID == bookingID && record.rating == 0.0f) {
-                record.rating = rating;
-                ratingSystem.addRating(record.driverPhone, rating);
-                saveHistory();
-                cout << "Rating submitted successfully!\n";
-                return;
-            }
+    struct Ride {
+        int64_t requested;
+        NodeId source, destination;
+        VehicleClass vehicle;
+        vector<NodeId> route;
+        float tripKm = 0.0f, fare = 0.0f;
+        uint32_t driver = 0;
+        int64_t pickedUp = 0;
+        bool waiting = false;
+    };
+    Graph& cityMap;
+    vector<Driver> fleet;
+    vector<int64_t> busySince;
+    unordered_map<string, uint32_t> slotByPhone;
+    DriverIndex index;
+    SurgeEngine surge;
+    // Every assigned driver drives the stops of its pool route; with sharing off each route carries one rider.
+    RidePool pool;
+    bool sharing;
+    vector<Ride> rides;
+    // Riders nobody could serve wait at their pickup node until a driver of their vehicle type frees up nearby.
+    array<unordered_map<NodeId, deque<uint32_t>>, VEHICLE_CLASSES> waitingAt;
+    array<size_t, VEHICLE_CLASSES> waitingCount{};
+    priority_queue<Event, vector<Event>, greater<Event>> events;
+    time_t dayStart;
+    size_t busy = 0;
+    SimulationReport report;
+    bool shares(const Ride& ride) const { return sharing && RidePool::seats(ride.vehicle) > 1; }
+    float chargeFare(Ride& ride, int64_t now) {
+        float multiplier = surge.multiplier(ride.source, ride.vehicle, dayStart + now);
+        ride.fare = BookingEngine::baseRate(ride.vehicle) * ride.tripKm * multiplier * (shares(ride) ? POOL_FARE_FACTOR : 1.0f);
+        report.surgeTotal += multiplier;
+        return multiplier;
+    }
+    void makeAvailable(uint32_t slot) {
+        fleet[slot].available = true;
+        index.insert(fleet[slot].vehicleClass, fleet[slot].node, slot);
+        surge.adjustSupply(fleet[slot].node, fleet[slot].vehicleClass, 1);
+    }
+    void assign(uint32_t id, uint32_t slot, float pickupKm, int etaMinutes, int64_t now) {
+        Ride& ride = rides[id];
+        index.erase(fleet[slot].vehicleClass, fleet[slot].node, slot);
+        fleet[slot].available = false;
+        surge.adjustSupply(fleet[slot].node, fleet[slot].vehicleClass, -1);
+        chargeFare(ride, now);
+        ride.driver = slot;
+        pool.open(fleet[slot].phone, ride.vehicle, shares(ride), fleet[slot].node, id, ride.source, ride.destination, pickupKm, ride.tripKm);
+        busySince[slot] = now;
+        report.pickupKm += pickupKm;
+        report.peakBusy = max(report.peakBusy, ++busy);
+        events.push({now + 60 * etaMinutes, EventType::Arrive, slot});
+    }
+    bool joinRoute(uint32_t id, const vector<DriverOffer>& offers, int64_t now) {
+        Ride& ride = rides[id];
+        RidePool::Insertion insertion = pool.bestInsertion(cityMap, ride.source, ride.destination, ride.vehicle, ride.tripKm,
+                                                           BookingEngine::poolPickupLimit(offers));
+        if (!BookingEngine::preferPooled(insertion, offers, ride.tripKm) || !pool.commit(insertion, id, ride.source, ride.destination, ride.tripKm)) return false;
+        chargeFare(ride, now);
+        ride.driver = slotByPhone[insertion.driverPhone];
+        vector<NodeId>().swap(ride.route);
+        report.pickupKm += insertion.pickupKm;
+        report.pooled++;
+        return true;
+    }
+    void request(uint32_t id, int64_t now) {
+        Ride& ride = rides[id];
+        time_t when = dayStart + now;
+        surge.recordRequest(ride.source, ride.vehicle, when);
+        tie(ride.tripKm, ride.route) = cityMap.shortestPath(ride.source, ride.destination);
+        if (ride.route.empty()) { report.unroutable++; return; }
+        vector<DriverOffer> offers;
+        for (auto [slot, km] : index.nearest(ride.vehicle, ride.source, 2 * DRIVER_CANDIDATES, MAX_PICKUP_KM)) {
+            offers.push_back({fleet[slot], km, BookingEngine::etaMinutes(km)});
+        }
+        BookingEngine::rankByEta(cityMap, ride.source, offers, when);
+        if (shares(ride) && joinRoute(id, offers, now)) return;
+        if (!offers.empty()) {
+            assign(id, slotByPhone[offers.front().driver.phone], offers.front().pickupKm, offers.front().etaMinutes, now);
+            return;
         }
-        cout << "Invalid booking ID or already rated.\n";
+        ride.waiting = true;
+        waitingAt[static_cast<size_t>(ride.vehicle)][ride.source].push_back(id);
+        waitingCount[static_cast<size_t>(ride.vehicle)]++;
+        report.queued++;
+        events.push({now + SIM_MAX_WAIT_SECONDS, EventType::Abandon, id});
     }
-    void saveHistory() {
-        ofstream fout(RIDE_HISTORY);
-        if (!fout.is_open()) {
-            cerr << "Error: Could not open " << RIDE_HISTORY << " for writing.\n";
+    void abandon(uint32_t id) {
+        Ride& ride = rides[id];
+        if (!ride.waiting) return;
+        auto& queues = waitingAt[static_cast<size_t>(ride.vehicle)];
+        deque<uint32_t>& queue = queues[ride.source];
+        queue.erase(find(queue.begin(), queue.end(), id));
+        if (queue.empty()) queues.erase(ride.source);
+        waitingCount[static_cast<size_t>(ride.vehicle)]--;
+        ride.waiting = false;
+        vector<NodeId>().swap(ride.route);
+        report.abandoned++;
+    }
+    bool serveWaiting(uint32_t slot, int64_t now) {
+        const Driver& driver = fleet[slot];
+        size_t vehicle = static_cast<size_t>(driver.vehicleClass);
+        if (waitingCount[vehicle] == 0) return false;
+        auto& queues = waitingAt[vehicle];
+        if (queues.size() <= 64 && none_of(queues.begin(), queues.end(), [&](const auto& waiting) {
+                return cityMap.distanceLowerBound(driver.node, waiting.first) <= MAX_PICKUP_KM;
+            })) return false;
+        NodeId found = INVALID_NODE;
+        float pickupKm = INF;
+        cityMap.searchFrom(driver.node, MAX_PICKUP_KM, [&](NodeId u, float d) {
+            if (!queues.count(u)) return true;
+            found = u; pickupKm = d;
+            return false;
+        });
+        if (found == INVALID_NODE) return false;
+        deque<uint32_t>& queue = queues[found];
+        uint32_t id = queue.front();
+        queue.pop_front();
+        if (queue.empty()) queues.erase(found);
+        waitingCount[vehicle]--;
+        rides[id].waiting = false;
+        float minutes = cityMap.travelMinutesTo(found, {driver.node}, dayStart + now)[0];
+        int eta = minutes < INF ? max(1, static_cast<int>(ceil(minutes))) : BookingEngine::etaMinutes(pickupKm);
+        makeAvailable(slot);
+        assign(id, slot, pickupKm, eta, now);
+        return true;
+    }
+    void arrive(uint32_t slot, int64_t now) {
+        Driver& driver = fleet[slot];
+        RidePool::Stop stop, next;
+        float legKm;
+        size_t onboard;
+        if (!pool.arrive(driver.phone, stop, legKm, onboard)) return;
+        Ride& ride = rides[stop.rider];
+        driver.node = stop.node;
+        report.vehicleKm += legKm;
+        if (onboard == 0) report.emptyKm += legKm;
+        if (stop.pickup) {
+            ride.pickedUp = now;
+            report.waitMinutes.push_back((now - ride.requested) / 60.0f);
+        } else {
+            report.served++;
+            report.tripKm += ride.tripKm;
+            report.tripMinutes += (now - ride.pickedUp) / 60.0;
+            report.revenue += ride.fare;
+        }
+        if (pool.nextStop(driver.phone, next)) {
+            // A rider going straight to their own drop-off reuses the route found when they booked.
+            bool direct = stop.pickup && next.rider == stop.rider && !ride.route.empty();
+            float minutes = cityMap.routeMinutes(direct ? ride.route : cityMap.shortestPath(stop.node, next.node).second, dayStart + now);
+            if (minutes == INF) minutes = (direct ? ride.tripKm : legKm) * 3;
+            vector<NodeId>().swap(ride.route);
+            events.push({now + max<int64_t>(60, static_cast<int64_t>(ceil(minutes * 60))), EventType::Arrive, slot});
             return;
         }
-        fout << "BookingID,User,UserPhone,Source,Destination,VehicleType,Fare,Driver,DriverPhone,Timestamp,Rating\n";
-        for (const auto& record : records) {
-            fout << record.bookingID << "," << record.user << "," << record.userPhone << ","
-                 << record.source << "," << record.destination << "," << record.vehicleType << ","
-                 << record.fare << "," << record.driverName << "," << record.driverPhone << ","
-                 << record.timestamp << "," << (record.rating > 0 ? to_string(record.rating) : "") << "\n";
+        driver.location = string(cityMap.locationName(driver.node));
+        busy--;
+        report.busyMinutes += (now - busySince[slot]) / 60.0;
+        if (!serveWaiting(slot, now)) makeAvailable(slot);
+    }
+public:
+    FleetSimulator(Graph& map, const vector<Driver>& drivers, time_t day, bool shareRides = false)
+        : cityMap(map), sharing(shareRides), dayStart(day) {
+        index.attach(&cityMap);
+        surge.attach(cityMap);
+        for (const auto& driver : drivers) {
+            NodeId node = cityMap.findLocation(driver.location);
+            if (node == INVALID_NODE || slotByPhone.count(driver.phone)) continue;
+            slotByPhone[driver.phone] = static_cast<uint32_t>(fleet.size());
+            fleet.push_back(driver);
+            fleet.back().node = node;
+            makeAvailable(static_cast<uint32_t>(fleet.size() - 1));
         }
-        fout.close();
+        busySince.assign(fleet.size(), 0);
     }
-    void logRide(const string& bookingID, const string& user, const string& phone,
-                 const string& src, const string& dest, const string& vehicle,
-                 float fare, const Driver& driver) {
-        time_t now = time(0);
-        string dt = ctime(&now); dt.pop_back();
-        records.push_back({bookingID, user, phone, src, dest, vehicle, fare, 
-                          driver.name, driver.phone, dt, 0.0f});
-        saveHistory();
+    size_t loadTrace(const string& path) {
+        CsvReader csv;
+        if (!csv.open(path, true)) return 0;
+        while (csv.next()) {
+            Ride ride;
+            if (!csv.parse(0, ride.requested) || csv[4].empty()) { csv.reject("expected second,phone,source,destination,vehicle type"); continue; }
+            ride.source = cityMap.findLocation(csv[2]);
+            ride.destination = cityMap.findLocation(csv[3]);
+            ride.vehicle = vehicleClassOf(csv[4]);
+            report.requests++;
+            if (ride.source == INVALID_NODE || ride.destination == INVALID_NODE || ride.vehicle == VehicleClass::Count) {
+                report.unroutable++;
+                continue;
+            }
+            events.push({ride.requested, EventType::Request, static_cast<uint32_t>(rides.size())});
+            rides.push_back(move(ride));
+        }
+        return report.requests;
+    }
+    SimulationReport run() {
+        auto start = chrono::steady_clock::now();
+        int64_t first = events.empty() ? 0 : events.top().at, now = first;
+        while (!events.empty()) {
+            Event event = events.top();
+            events.pop();
+            now = event.at;
+            report.events++;
+            if (event.type == EventType::Request) request(event.id, now);
+            else if (event.type == EventType::Abandon) abandon(event.id);
+            else arrive(event.id, now);
+        }
+        sort(report.waitMinutes.begin(), report.waitMinutes.end());
+        report.drivers = fleet.size();
+        report.simulatedSeconds = now - first;
+        report.wallMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return report;
     }
-    size_t getRideCount() const { return records.size(); }
 };
 
 class RideBookingSystem {
@@ -452,220 +4143,172 @@ private:
     UserManager userManager;
     RideHistory rideHistory;
     RatingSystem ratingSystem;
+    BookingEngine engine{cityMap, driverManager, userManager, rideHistory, ratingSystem};
+    RideAnalytics analytics;
+    MetricsDumper metricsDumper{METRICS_FILE, METRICS_DUMP_INTERVAL};
+    unique_ptr<TrafficFeed> trafficFeed;
 public:
     RideBookingSystem() {
         loadCityMap();
+        driverManager.attachMap(cityMap);
         ratingSystem.loadRatings();
         rideHistory.loadHistory();
+        if (size_t profiled = cityMap.loadTrafficProfiles(TRAFFIC_PROFILES)) {
+            cout << "Loaded traffic profiles for " << profiled << " roads from " << TRAFFIC_PROFILES << ".\n";
+        }
+        trafficFeed = make_unique<TrafficFeed>(cityMap, TRAFFIC_UPDATES, TRAFFIC_POLL_INTERVAL);
     }
     void loadCityMap() {
-        ifstream file(DATA_PATH);
-        if (!file.is_open()) {
-            cerr << "Warning: Could not open " << DATA_PATH << ". Using default edges.\n";
-            cityMap.addEdge("Saket", "INA", 7.54);
-            cityMap.addEdge("Saket", "Lajpat Nagar", 5.2);
-            cityMap.addEdge("Lajpat Nagar", "INA", 4.0);
-            cityMap.addEdge("Saket", "Connaught Place", 10.5);
-            cityMap.addEdge("Saket", "RK Puram", 4.8);
-            cityMap.addEdge("Saket", "Jasola", 6.0);
+        ScopedTimer timer(Metric::GraphLoad);
+        struct stat csvInfo;
+        bool haveCsv = stat(DATA_PATH.c_str(), &csvInfo) == 0;
+        if (haveCsv && cityMap.loadSnapshot(SNAPSHOT_FILE, csvInfo.st_size, csvInfo.st_mtime)) {
+            cout << "Loaded " << cityMap.edgeCount() << " edges between " << cityMap.nodeCount()
+                 << " locations from " << SNAPSHOT_FILE << ".\n";
         } else {
-            string line; getline(file, line);
-            while (getline(file, line)) {
-                stringstream ss(line);
-                string from, to, distStr;
-                getline(ss, from, ','); getline(ss, to, ','); getline(ss, distStr, ',');
-                try { 
-                    cityMap.addEdge(from, to, stof(distStr)); 
-                    cout << "Added edge: " << from << " -> " << to << " (" << distStr << " km)\n";
-                } catch (...) { continue; }
-            }
-            file.close();
-        }
-        cityMap.addLocation("Connaught Place", 28.6333, 77.2167);
-        cityMap.addLocation("Lajpat Nagar", 28.5675, 77.2431);
-        cityMap.addLocation("RK Puram", 28.5611, 77.1747);
-        cityMap.addLocation("Saket", 28.5244, 77.2069);
-        cityMap.addLocation("Jasola", 28.5422, 77.2847);
-        cityMap.addLocation("INA", 28.5833, 77.2167);
+            if (!cityMap.loadEdgesCsv(DATA_PATH)) {
+                cerr << "Warning: Could not open " << DATA_PATH << ". Using default edges.\n";
+                cityMap.addEdge("Saket", "INA", 7.54);
+                cityMap.addEdge("Saket", "Lajpat Nagar", 5.2);
+                cityMap.addEdge("Lajpat Nagar", "INA", 4.0);
+                cityMap.addEdge("Saket", "Connaught Place", 10.5);
+                cityMap.addEdge("Saket", "RK Puram", 4.8);
+                cityMap.addEdge("Saket", "Jasola", 6.0);
+            } else {
+                cout << "Loaded " << cityMap.edgeCount() << " edges between " << cityMap.nodeCount()
+                     << " locations from " << DATA_PATH << ".\n";
+            }
+            if (haveCsv && cityMap.saveSnapshot(SNAPSHOT_FILE, csvInfo.st_size, csvInfo.st_mtime)) {
+                cout << "Compiled city map snapshot to " << SNAPSHOT_FILE << ".\n";
+            }
+        }
+        loadCoordinates();
         if (cityMap.locationExists("Saket")) {
             cout << "Saket is in the graph.\n";
         } else {
             cout << "Error: Saket not found in graph!\n";
             cityMap.addEdge("Saket", "INA", 7.54);
         }
+        cityMap.calibrateHeuristic();
+        if (cityMap.getHeuristicScale() <= 0) {
+            cerr << "Warning: Some locations have no coordinates, so A* and the driver grid prefilter use plain search.\n";
+        }
+        cityMap.prepareHierarchy(HIERARCHY_FILE);
     }
-    string generateOTP() {
-        random_device rd; mt19937 gen(rd());
-        return to_string(uniform_int_distribution<>(1000, 9999)(gen));
-    }
-    string generateBookingID() {
-        random_device rd; mt19937 gen(rd());
-        return "UB" + to_string(uniform_int_distribution<>(10000, 99999)(gen));
+    void loadCoordinates() {
+        size_t loaded = cityMap.loadCoordinatesCsv(COORDS_FILE);
+        if (loaded == 0) {
+            cerr << "Warning: No coordinates loaded from " << COORDS_FILE << ". Using default coordinates.\n";
+            cityMap.addLocation("Connaught Place", 28.6333, 77.2167);
+            cityMap.addLocation("Lajpat Nagar", 28.5675, 77.2431);
+            cityMap.addLocation("RK Puram", 28.5611, 77.1747);
+            cityMap.addLocation("Saket", 28.5244, 77.2069);
+            cityMap.addLocation("Jasola", 28.5422, 77.2847);
+            cityMap.addLocation("INA", 28.5833, 77.2167);
+            return;
+        }
+        cout << "Loaded coordinates for " << loaded << " of " << cityMap.nodeCount() << " locations.\n";
     }
     void bookRide() {
         cout << "\n=== Book a Ride ===\n";
-        string username, phone;
-        cout << "Enter your name: "; getline(cin, username);
+        BookingRequest request;
+        cout << "Enter your name: "; getline(cin, request.riderName);
         while (true) {
-            cout << "Phone number (10 digits): "; getline(cin, phone);
-            if (phone.length() == 10 && all_of(phone.begin(), phone.end(), ::isdigit)) break;
+            cout << "Phone number (10 digits): "; getline(cin, request.phone);
+            if (request.phone.length() == 10 && all_of(request.phone.begin(), request.phone.end(), ::isdigit)) break;
             cout << "Invalid number! Try again.\n";
         }
-        if (!userManager.userExists(phone)) {
+        if (!userManager.userExists(request.phone)) {
             cout << "\nCreating new account...\n";
-            userManager.createUser(username, phone);
-        }
-        UserAccount* user = userManager.getUser(phone);
-        if (!user) { cout << "Error accessing account.\n"; return; }
-        user->displayProfile();
-        string source, destination;
-        cout << "\nEnter your current location: "; getline(cin, source);
-        cout << "Enter your destination: "; getline(cin, destination);
-        if (!cityMap.locationExists(source) || !cityMap.locationExists(destination)) {
-            cout << "Location not found in database.\n"; return; }
+            userManager.createUser(request.riderName, request.phone);
+        }
+        UserAccount user;
+        if (!userManager.getUser(request.phone, user)) { cout << "Error accessing account.\n"; return; }
+        user.displayProfile();
+        if (!readLocation("\nEnter your current location: ", request.source)) return;
+        if (!readLocation("Enter your destination: ", request.destination)) return;
         cout << "\nSelect vehicle type:\n1. 2-wheeler (RS 10/km)\n2. 4-seater car (RS 15/km)\n3. 7-seater SUV (RS 20/km)\nEnter choice: ";
         int vehicleChoice; cin >> vehicleChoice; cin.ignore();
-        string vehicle = vehicleChoice == 1 ? "2-wheeler" : vehicleChoice == 2 ? "4-seater" : vehicleChoice == 3 ? "7-seater" : "";
-        if (vehicle.empty()) { cout << "Invalid choice. Booking cancelled.\n"; return; }
-        auto [distance, path] = cityMap.shortestPath(source, destination);
-        if (path.empty()) { cout << "No route found.\n"; return; }
-        float baseRate = vehicle == "2-wheeler" ? 10.0 : vehicle == "4-seater" ? 15.0 : 20.0;
-        float fare = baseRate * distance;
-        time_t now = time(0); tm* ltm = localtime(&now);
-        if ((ltm->tm_hour >= 17 && ltm->tm_hour <= 20) || (ltm->tm_hour >= 8 && ltm->tm_hour <= 10)) {
-            fare *= 1.25f; cout << "\nNote: Surge pricing (1.25x) applied due to peak hours.\n";
+        request.vehicleType = vehicleChoice == 1 ? "2-wheeler" : vehicleChoice == 2 ? "4-seater" : vehicleChoice == 3 ? "7-seater" : "";
+        if (request.vehicleType.empty()) { cout << "Invalid choice. Booking cancelled.\n"; return; }
+        if (RidePool::seats(vehicleClassOf(request.vehicleType)) > 1) {
+            cout << "Share this ride with other riders for " << static_cast<int>((1 - POOL_FARE_FACTOR) * 100) << "% off? (y/n): ";
+            char share; cin >> share; cin.ignore();
+            request.shared = tolower(share) == 'y';
+        }
+        RideQuote quote = engine.quote(request);
+        if (quote.status == BookingStatus::NoRoute) { cout << "No route found.\n"; return; }
+        if (quote.surgeMultiplier > 1.0f) {
+            cout << "\nNote: Surge pricing (" << fixed << setprecision(2) << quote.surgeMultiplier << "x) applied due to high demand nearby.\n";
         }
         cout << fixed << setprecision(2);
-        cout << "\n=== Ride Details ===\nDistance: " << distance << " km\nEstimated Fare: RS " << fare << "\nRoute: ";
+        cout << "\n=== Ride Details ===\nDistance: " << quote.distance << " km\nEstimated Fare: RS " << quote.fare;
+        if (quote.tripMinutes < INF) cout << "\nEstimated trip time: " << static_cast<int>(ceil(quote.tripMinutes)) << " mins";
+        cout << "\nRoute: ";
+        const vector<NodeId>& path = quote.route;
         for (size_t i = 0; i < min(path.size(), size_t(5)); i++) {
-            cout << path[i] << (i < min(path.size(), size_t(5)) - 1 ? " -> " : "");
+            cout << cityMap.locationName(path[i]) << (i < min(path.size(), size_t(5)) - 1 ? " -> " : "");
         }
-        if (path.size() > 5) cout << " -> ... -> " << path.back();
+        if (path.size() > 5) cout << " -> ... -> " << cityMap.locationName(path.back());
         cout << "\n";
-        vector<Driver> allDrivers = driverManager.getAllDrivers();
-        vector<pair<Driver, int>> availableDrivers;
-        for (const auto& driver : allDrivers) {
-            if (driver.vehicleType == vehicle && driver.available) {
-                auto [driverDist, _] = cityMap.shortestPath(driver.location, source);
-                if (driverDist != INF) {
-                    int eta = max(1, static_cast<int>(driverDist * 3));
-                    availableDrivers.emplace_back(driver, eta);
-                }
-            }
-        }
-        if (availableDrivers.empty()) {
+        if (quote.status == BookingStatus::NoDrivers) {
             cout << "No drivers available. Initializing default drivers...\n";
             driverManager.loadDrivers();
-            allDrivers = driverManager.getAllDrivers();
-            for (const auto& driver : allDrivers) {
-                if (driver.vehicleType == vehicle && driver.available) {
-                    auto [driverDist, _] = cityMap.shortestPath(driver.location, source);
-                    if (driverDist != INF) {
-                        int eta = max(1, static_cast<int>(driverDist * 3));
-                        availableDrivers.emplace_back(driver, eta);
-                    }
-                }
-            }
-            if (availableDrivers.empty()) {
-                cout << "No drivers available for " << vehicle << ". Would you like to try another vehicle type? (y/n): ";
+            quote = engine.quote(request, time(0), false);
+            if (quote.status == BookingStatus::NoDrivers) {
+                cout << "No drivers available for " << request.vehicleType << ". Would you like to try another vehicle type? (y/n): ";
                 char retry; cin >> retry; cin.ignore();
                 if (tolower(retry) == 'y') {
-                    cout <<("\nSelect vehicle type:\n1. 2-wheeler (RS 10/km)\nstartxref2. 4-seater car (RS 15/km)\n3. 7-seater SUV (RS 20/km)\nEnter choice: ");
+                    cout <<("\nSelect vehicle type:\n1. 2-wheeler (RS 10/km)\n2. 4-seater car (RS 15/km)\n3. 7-seater SUV (RS 20/km)\nEnter choice: ");
                     int newChoice; cin >> newChoice; cin.ignore();
-                    vehicle = newChoice == 1 ? "2-wheeler" : newChoice == 2 ? "4-seater" : newChoice == 3 ? "7-seater" : "";
-                    baseRate = vehicle == "2-wheeler" ? 10.0 : vehicle == "4-seater" ? 15.0 : 20.0;
-                    fare = baseRate * distance;
-                    if ((ltm->tm_hour >= 17 && ltm->tm_hour <= 20) || (ltm->tm_hour >= 8 && ltm->tm_hour <= 10)) {
-                        fare *= 1.25f;
-                    }
-                    if (!vehicle.empty()) {
-                        for (const auto& driver : allDrivers) {
-                            if (driver.vehicleType == vehicle && driver.available) {
-                                auto [driverDist, _] = cityMap.shortestPath(driver.location, source);
-                                if (driverDist != INF) {
-                                    int eta = max(1, static_cast<int>(driverDist * 3));
-                                    availableDrivers.emplace_back(driver, eta);
-                                }
-                            }
-                        }
-                    }
+                    request.vehicleType = newChoice == 1 ? "2-wheeler" : newChoice == 2 ? "4-seater" : newChoice == 3 ? "7-seater" : "";
+                    if (!request.vehicleType.empty()) quote = engine.quote(request);
                 }
-                if (availableDrivers.empty()) {
+                if (quote.status != BookingStatus::Ok) {
                     cout << "Still no drivers available. Please try again later.\n";
                     return;
                 }
             }
         }
-        sort(availableDrivers.begin(), availableDrivers.end(), [](auto& a, auto& b) { return a.second < b.second; });
+        if (quote.pooled) cout << "\nJoining a shared ride already on its way (" << quote.insertion.addedKm << " km detour for the driver).\n";
         cout << "\nAvailable Drivers:\n";
-        for (size_t i = 0; i < min(size_t(3), availableDrivers.size()); i++) {
-            auto [driver, eta] = availableDrivers[i];
-            cout << i+1 << ". " << driver.name << " (" << driver.vehicleType << ") - ETA: " << eta << " mins - ";
-            ratingSystem.displayDriverRating(driver.phone);
+        for (size_t i = 0; i < min(size_t(3), quote.drivers.size()); i++) {
+            const DriverOffer& offer = quote.drivers[i];
+            cout << i+1 << ". " << offer.driver.name << " (" << offer.driver.vehicleType << ") - ETA: " << offer.etaMinutes << " mins - ";
+            ratingSystem.displayDriverRating(offer.driver.phone);
         }
         cout << "\nConfirm booking? (y/n): ";
         char confirm; cin >> confirm; cin.ignore();
         if (tolower(confirm) != 'y') { cout << "Booking cancelled.\n"; return; }
-        auto [driver, eta] = availableDrivers[0];
-        for (auto& d : driverManager.getAllDrivers()) {
-            if (d.phone == driver.phone) { d.available = false; break; }
-        }
-        driverManager.saveDrivers();
-        cout << "\n=== Payment ===\nAmount: RS " << fare << "\nPayment method: " << user->getPaymentMethod() << "\n";
-        bool paymentSuccess = false;
-        if (user->getPaymentMethod() == "Wallet") {
-            if (user->getBalance() >= fare) {
-                paymentSuccess = user->makePayment(fare);
-                if (paymentSuccess) cout << "Payment successful from wallet.\n";
-            } else {
-                cout << "Insufficient wallet balance (RS " << user->getBalance() << "). Please pay RS " << fare << " in cash.\n";
-                paymentSuccess = true; // Assume cash payment is successful
-            }
-        } else {
-            cout << "Please pay RS " << fare << " in cash.\n";
-            paymentSuccess = true; // Cash payment assumed successful
-        }
-        if (!paymentSuccess) {
-            cout << "Payment failed. Booking cancelled.\n";
-            for (auto& d : driverManager.getAllDrivers()) {
-                if (d.phone == driver.phone) { d.available = true; break; }
-            }
-            driverManager.saveDrivers();
-            return;
+        BookingResult booking = engine.confirm(request, quote);
+        if (booking.status != BookingStatus::Ok) { cout << "Driver is no longer available. Please try again.\n"; return; }
+        const Driver& driver = booking.assigned.driver;
+        float fare = booking.fare;
+        cout << fixed << setprecision(2) << "\n=== Payment ===\nAmount: RS " << fare << "\nPayment method: " << booking.paymentMode << "\n";
+        if (booking.paidFromWallet) cout << "Payment successful from wallet.\n";
+        else if (booking.paymentMode == "Wallet" && userManager.getUser(request.phone, user)) {
+            cout << "Insufficient wallet balance (RS " << user.getBalance() << "). Please pay RS " << fare << " in cash.\n";
         }
-        string otp = generateOTP(), bookingID = generateBookingID();
-        cout << "\n=== Booking Confirmed ===\nBooking ID: " << bookingID 
+        else cout << "Please pay RS " << fare << " in cash.\n";
+        cout << "\n=== Booking Confirmed ===\nBooking ID: " << booking.bookingID
              << "\nDriver: " << driver.name << " (" << driver.phone << ")\nVehicle: " 
-             << driver.vehicleType << "\nETA: " << eta << " minutes\nOTP: " << otp << "\n";
+             << driver.vehicleType << "\nETA: " << booking.assigned.etaMinutes << " minutes\nOTP: " << booking.otp << "\n";
         string inputOTP;
         cout << "Driver, enter OTP: "; cin >> inputOTP; cin.ignore();
-        if (inputOTP != otp) {
+        if (inputOTP != booking.otp) {
             cout << "Invalid OTP. Ride cancelled.\n";
-            if (user->getPaymentMethod() == "Wallet" && paymentSuccess) {
-                user->addToWallet(fare); cout << "Amount refunded to wallet.\n";
-            }
-            for (auto& d : driverManager.getAllDrivers()) {
-                if (d.phone == driver.phone) { d.available = true; break; }
-            }
-            driverManager.saveDrivers();
+            engine.cancel(request, booking);
+            if (booking.paidFromWallet) cout << "Amount refunded to wallet.\n";
             return;
         }
-        cout << "\nDriver is on the way...\n";
-        for (int i = eta; i > 0; --i) {
-            if (i % 5 == 0 || i <= 3) cout << "Arriving in " << i << " minute(s)...\n";
-            this_thread::sleep_for(chrono::milliseconds(100));
-        }
+        cout << "\nDriver is on the way, arriving in " << booking.assigned.etaMinutes << " minute(s)...\n";
         cout << "\nYou have reached your destination!\nTotal Fare: RS " << fare << "\n";
-        rideHistory.logRide(bookingID, username, phone, source, destination, vehicle, fare, driver);
-        for (auto& d : driverManager.getAllDrivers()) {
-            if (d.phone == driver.phone) { d.available = true; break; }
-        }
-        driverManager.saveDrivers();
+        engine.complete(request, booking);
         cout << "\n=== Rate Your Ride ===\nEnter rating (1-5 stars): ";
         float rating; cin >> rating; cin.ignore();
         if (rating >= 1 && rating <= 5) {
-            rideHistory.addRating(bookingID, rating, ratingSystem);
-            ratingSystem.saveRatings();
+            if (engine.rate(booking.bookingID, rating)) cout << "Rating submitted successfully!\n";
+            else cout << "Invalid booking ID or already rated.\n";
         } else cout << "Invalid rating. Rate later from history.\n";
         cout << "\nThank you for using our service!\n";
     }
@@ -673,18 +4316,18 @@ public:
         cout << "\n=== Account Management ===\n";
         string phone;
         cout << "Enter your phone number: "; getline(cin, phone);
-        UserAccount* user = userManager.getUser(phone);
-        if (!user) { cout << "Account not found.\n"; return; }
-        user->displayProfile();
+        UserAccount user;
+        if (!userManager.getUser(phone, user)) { cout << "Account not found.\n"; return; }
+        user.displayProfile();
         cout << "\n1. Add money to wallet\n2. Change payment method\n3. Back\nEnter choice: ";
         int choice; cin >> choice; cin.ignore();
         if (choice == 1) {
             cout << "Enter amount to add: RS ";
             float amount; cin >> amount; cin.ignore();
             if (amount > 0) {
-                user->addToWallet(amount);
-                userManager.saveUsers();
-                cout << "Wallet updated. New balance: RS " << user->getBalance() << "\n";
+                userManager.creditWallet(phone, amount);
+                userManager.getUser(phone, user);
+                cout << "Wallet updated. New balance: RS " << user.getBalance() << "\n";
             } else cout << "Invalid amount.\n";
         } else if (choice == 2) {
             string method;
@@ -694,16 +4337,37 @@ public:
                 cout << "Invalid payment method! Please choose Cash or Wallet.\n";
             }
             method = normalize(method) == "cash" ? "Cash" : "Wallet";
-            user->updatePaymentMethod(method);
-            userManager.saveUsers();
+            userManager.setPaymentMethod(phone, method);
             cout << "Payment method updated.\n";
         }
     }
+    bool readLocation(const string& prompt, string& location) {
+        cout << prompt; getline(cin, location);
+        if (cityMap.locationExists(location)) return true;
+        vector<NodeId> suggestions = cityMap.suggestLocations(location);
+        if (suggestions.empty()) { cout << "Location not found in database.\n"; return false; }
+        cout << "Location not found. Did you mean:\n";
+        for (size_t i = 0; i < suggestions.size(); i++) cout << i+1 << ". " << cityMap.locationName(suggestions[i]) << "\n";
+        cout << "Enter choice (0 to cancel): ";
+        size_t choice; cin >> choice; cin.ignore();
+        if (choice == 0 || choice > suggestions.size()) { cout << "Booking cancelled.\n"; return false; }
+        location = string(cityMap.locationName(suggestions[choice - 1]));
+        return true;
+    }
     void viewRideHistory() {
         cout << "\n=== Ride History ===\n";
         string phone;
         cout << "Enter your phone number: "; getline(cin, phone);
-        rideHistory.displayUserHistory(phone);
+        size_t pageNumber = 0;
+        while (true) {
+            size_t pages = rideHistory.displayUserHistory(phone, pageNumber);
+            if (pages <= 1) return;
+            cout << "n = next page, p = previous page, q = back: ";
+            string action; getline(cin, action);
+            if (action == "n" && pageNumber + 1 < pages) pageNumber++;
+            else if (action == "p" && pageNumber > 0) pageNumber--;
+            else if (action != "n" && action != "p") return;
+        }
     }
     void driverMenu() {
         cout << "\n=== Driver Menu ===\n1. Register\n2. Toggle Availability\n3. Back\nEnter choice: ";
@@ -719,10 +4383,211 @@ public:
         cout << "\n=== Admin Menu ===\n";
         cout << "Total Users: " << userManager.getUserCount() << "\n";
         cout << "Total Drivers: " << driverManager.getDriverCount() << "\n";
+        cout << "Available Drivers:";
+        for (size_t vehicle = 0; vehicle < VEHICLE_CLASSES; vehicle++) {
+            cout << (vehicle ? ", " : " ") << vehicleName(static_cast<VehicleClass>(vehicle)) << " " << driverManager.availableCount(static_cast<VehicleClass>(vehicle));
+        }
+        cout << "\n";
         cout << "Total Rides: " << rideHistory.getRideCount() << "\n";
+        cout << "Routing Mode: " << searchModeName(cityMap.getSearchMode()) << "\n";
+        const PathCache& cache = cityMap.getPathCache();
+        PathCache::Stats cacheStats = cache.getStats();
+        cout << "Path Cache: " << cacheStats.pairHits << " route hits, " << cacheStats.treeHits << " tree hits, "
+             << cacheStats.misses << " misses, " << cache.size() << " entries ("
+             << cache.memoryUsed() / 1024 << " KB), " << cacheStats.evictions << " evictions, "
+             << cacheStats.invalidations << " invalidations\n";
+        const TrafficModel& traffic = cityMap.getTraffic();
+        TrafficFeed::Stats feedStats = trafficFeed->getStats();
+        EtaCache::Stats etaStats = cityMap.getEtaCache().getStats();
+        cout << "Traffic: version " << traffic.getVersion() << ", " << traffic.liveEdges(time(0)) << " live roads, "
+             << traffic.profiledEdges() << " profiled roads, last batch " << feedStats.lastEdges << " roads in "
+             << fixed << setprecision(2) << feedStats.lastMillis << " ms\n";
+        cout << "ETA Cache: " << etaStats.hits << " hits, " << etaStats.misses << " misses, " << cityMap.getEtaCache().size()
+             << " entries, " << etaStats.invalidated << " invalidated, " << etaStats.flushes << " flushes\n";
+        const SurgeEngine& surge = driverManager.surgePricing();
+        auto [surging, peakSurge] = surge.surgingZones(time(0));
+        cout << "Surge: " << surging << " zone/vehicle pairs surging across " << surge.zoneCount() << " zones, peak "
+             << peakSurge << "x\n";
+        cout << "\n1. Change routing mode\n2. Run dispatch load test\n3. Run batch matching\n4. Analytics reports\n5. Metrics\n6. Simulate booking trace\n7. Back\nEnter choice: ";
+        int choice; cin >> choice; cin.ignore();
+        if (choice == 1) {
+            cout << "1. Dijkstra\n2. Bidirectional Dijkstra\n3. A* (haversine)\n4. Contraction Hierarchy\nEnter choice: ";
+            int mode; cin >> mode; cin.ignore();
+            if (mode == 1) cityMap.setSearchMode(SearchMode::Dijkstra);
+            else if (mode == 2) cityMap.setSearchMode(SearchMode::Bidirectional);
+            else if (mode == 3) cityMap.setSearchMode(SearchMode::AStar);
+            else if (mode == 4) cityMap.setSearchMode(SearchMode::Hierarchy);
+            else { cout << "Invalid choice.\n"; return; }
+            cout << "Routing mode set to " << searchModeName(cityMap.getSearchMode()) << ".\n";
+        } else if (choice == 2) {
+            cout << "Number of booking requests: ";
+            size_t requests; cin >> requests; cin.ignore();
+            runDispatchLoadTest(requests);
+        } else if (choice == 3) {
+            cout << "Number of riders in the window: ";
+            size_t riders; cin >> riders; cin.ignore();
+            runBatchMatching(riders);
+        } else if (choice == 4) {
+            analyticsReports();
+        } else if (choice == 5) {
+            metricsView();
+        } else if (choice == 6) {
+            cout << "Let 4-seater and 7-seater riders share rides? (y/n): ";
+            char share; cin >> share; cin.ignore();
+            runSimulation(BOOKING_TRACE, tolower(share) == 'y');
+        }
+    }
+    void runSimulation(const string& tracePath, bool sharing = false) {
+        time_t now = time(0);
+        tm local{};
+#ifdef _WIN32
+        localtime_s(&local, &now);
+#else
+        localtime_r(&now, &local);
+#endif
+        FleetSimulator simulator(cityMap, driverManager.getAllDrivers(), now - (local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec), sharing);
+        if (simulator.loadTrace(tracePath) == 0) { cout << "No booking requests found in " << tracePath << ".\n"; return; }
+        SimulationReport report = simulator.run();
+        double hours = report.simulatedSeconds / 3600.0;
+        cout << fixed << setprecision(2);
+        cout << "\n=== Simulation (" << tracePath << ", " << report.drivers << " drivers, " << searchModeName(cityMap.getSearchMode())
+             << (sharing ? ", shared rides" : "") << ") ===\n";
+        cout << "Simulated " << hours << " h in " << report.wallMs / 1000 << " s (" << setprecision(0)
+             << report.simulatedSeconds * 1000.0 / max(report.wallMs, 1e-3) << "x real time), " << report.events << " events\n";
+        cout << "Requests: " << report.requests << ", served " << report.served << " (" << setprecision(1)
+             << 100.0 * report.served / report.requests << "%), abandoned " << report.abandoned << ", unroutable "
+             << report.unroutable << ", " << report.queued << " queued for a driver\n";
+        cout << setprecision(2) << "Pickup wait: mean " << (report.served ? accumulate(report.waitMinutes.begin(), report.waitMinutes.end(), 0.0) / report.waitMinutes.size() : 0.0)
+             << " min, p50 " << report.waitPercentile(50) << ", p90 " << report.waitPercentile(90) << ", p99 " << report.waitPercentile(99) << "\n";
+        if (report.served > 0) {
+            cout << "Trips: " << report.tripKm / report.served << " km and " << report.tripMinutes / report.served << " min on average, "
+                 << report.pickupKm / report.served << " km to each pickup\n";
+            if (sharing) cout << "Shared: " << report.pooled << " riders (" << setprecision(1) << 100.0 * report.pooled / report.served
+                              << "%) joined a route already under way\n" << setprecision(2);
+            cout << "Vehicle km: " << report.vehicleKm << " driven, " << report.emptyKm << " empty, "
+                 << report.tripKm / max(report.vehicleKm - report.emptyKm, 1e-9) << " rider km per occupied km\n";
+            cout << "Fleet: " << setprecision(1) << 100.0 * report.busyMinutes / max(1.0, report.drivers * hours * 60) << "% utilised, peak "
+                 << report.peakBusy << " vehicles busy\n";
+            cout << "Revenue: RS " << setprecision(2) << report.revenue << ", mean surge " << report.surgeTotal / report.served << "x\n";
+        }
+    }
+    void metricsView() {
+        Metrics::Snapshot current = Metrics::snapshot();
+        cout << "\n=== Metrics ===\n" << left << setw(20) << "Operation" << right << setw(10) << "Count"
+             << setw(12) << "Mean us" << setw(12) << "p50 us" << setw(12) << "p90 us" << setw(12) << "p99 us" << "\n";
+        cout << fixed << setprecision(1);
+        for (size_t m = 0; m < Metrics::TIMERS; m++) {
+            const Metrics::Timer& timer = current.timers[m];
+            cout << left << setw(20) << Metrics::name(static_cast<Metric>(m)) << right << setw(10) << timer.count
+                 << setw(12) << timer.meanMicros() << setw(12) << timer.percentileMicros(50)
+                 << setw(12) << timer.percentileMicros(90) << setw(12) << timer.percentileMicros(99) << "\n";
+        }
+        for (size_t c = 0; c < Metrics::COUNTERS; c++) {
+            cout << Metrics::name(static_cast<Counter>(c)) << ": " << current.counters[c] << "\n";
+        }
+        cout << "Percentiles are bucket upper bounds. Written to " << METRICS_FILE << " every "
+             << METRICS_DUMP_INTERVAL.count() << " s.\n";
+    }
+    void analyticsReports() {
+        auto start = chrono::steady_clock::now();
+        analytics.refresh(rideHistory);
+        double refreshMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << "\n=== Analytics (" << analytics.rows() << " rides, refreshed in " << fixed << setprecision(2) << refreshMs << " ms) ===\n"
+             << "1. Revenue by hour and vehicle type\n2. Top routes\n3. Driver earnings\n4. Average rating\n5. Back\nEnter choice: ";
+        int choice; cin >> choice; cin.ignore();
+        start = chrono::steady_clock::now();
+        if (choice == 1) {
+            vector<float> revenue = analytics.revenueByHourAndVehicle();
+            const Dictionary& kinds = analytics.vehicleTypes();
+            cout << "Hour";
+            for (size_t v = 0; v < kinds.size(); v++) cout << setw(14) << kinds.decode(static_cast<uint32_t>(v));
+            cout << "\n" << setprecision(0);
+            for (int hour = 0; hour < 24; hour++) {
+                cout << setw(4) << hour;
+                for (size_t v = 0; v < kinds.size(); v++) cout << setw(14) << revenue[hour * kinds.size() + v];
+                cout << "\n";
+            }
+        } else if (choice == 2) {
+            for (const auto& route : analytics.topRoutes(10)) {
+                cout << analytics.locationName(route.source) << " -> " << analytics.locationName(route.destination)
+                     << ": " << route.rides << " rides, RS " << setprecision(2) << route.revenue << "\n";
+            }
+        } else if (choice == 3) {
+            for (const auto& driver : analytics.topDrivers(10)) {
+                cout << analytics.driverName(driver.driver) << " (" << analytics.driverPhone(driver.driver) << "): "
+                     << driver.rides << " rides, RS " << setprecision(2) << driver.earnings << ", rating "
+                     << setprecision(1) << driver.rating << "\n";
+            }
+        } else if (choice == 4) {
+            auto [average, rated] = analytics.averageRating();
+            cout << "Average rating: " << setprecision(2) << average << "/5 over " << rated << " rated rides\n";
+        } else return;
+        cout << "(computed in " << setprecision(3) << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms)\n";
+    }
+    void runBatchMatching(size_t riders) {
+        vector<BookingRequest> batch = syntheticRequests(riders);
+        if (batch.empty()) { cout << "Nothing to dispatch.\n"; return; }
+        BatchReport report;
+        {
+            BatchDispatcher dispatcher(engine, driverManager, cityMap, BATCH_WINDOW, false);
+            vector<future<BookingResult>> pending;
+            for (const auto& request : batch) pending.push_back(dispatcher.submit(request));
+            for (size_t i = 0; i < pending.size(); i++) engine.cancel(batch[i], pending[i].get());
+            report = dispatcher.getTotals();
+        }
+        cout << fixed << setprecision(2);
+        cout << "Window of " << BATCH_WINDOW.count() << " ms, " << report.riders << " riders\n";
+        cout << "Batch assignment: " << report.matched << " matched, " << report.pickupKm << " km total pickup\n";
+        cout << "Greedy nearest:   " << report.greedyMatched << " matched, " << report.greedyPickupKm << " km total pickup\n";
+        cout << "Solver time: " << setprecision(3) << report.solveMs << " ms\n";
+    }
+    vector<BookingRequest> syntheticRequests(size_t count) {
+        vector<BookingRequest> batch;
+        vector<string> phones = userManager.getPhones();
+        if (phones.empty() || cityMap.nodeCount() < 2) return batch;
+        const char* vehicles[] = {"2-wheeler", "4-seater", "7-seater"};
+        mt19937 gen(42);
+        for (size_t i = 0; i < count; i++) {
+            NodeId s = gen() % cityMap.nodeCount(), d = gen() % cityMap.nodeCount();
+            batch.push_back({"Load Test", phones[gen() % phones.size()], string(cityMap.locationName(s)),
+                             string(cityMap.locationName(d)), vehicles[gen() % 3], "Cash"});
+        }
+        return batch;
+    }
+    void runDispatchLoadTest(size_t requests) {
+        vector<BookingRequest> batch = syntheticRequests(requests);
+        if (batch.empty()) { cout << "Nothing to dispatch.\n"; return; }
+        size_t cores = max(1u, thread::hardware_concurrency());
+        for (size_t threads : {size_t(1), cores}) {
+            size_t confirmed = 0, noDrivers = 0, contended = 0;
+            auto start = chrono::steady_clock::now();
+            {
+                DispatchPool pool(engine, threads);
+                vector<future<BookingResult>> pending;
+                for (const auto& request : batch) {
+                    pending.push_back(pool.submit([this, &request] {
+                        BookingResult result = engine.dispatch(request, false);
+                        engine.cancel(request, result);
+                        return result;
+                    }));
+                }
+                for (auto& result : pending) {
+                    BookingStatus status = result.get().status;
+                    if (status == BookingStatus::Ok) confirmed++;
+                    else if (status == BookingStatus::DriverUnavailable) contended++;
+                    else noDrivers++;
+                }
+            }
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            cout << threads << " worker(s): " << confirmed << " confirmed, " << contended << " lost to contention, "
+                 << noDrivers << " without drivers in " << fixed << setprecision(3) << seconds << " s ("
+                 << setprecision(0) << requests / max(seconds, 1e-9) << " bookings/s)\n";
+            if (cores == 1) break;
+        }
     }
 };
 
+#ifndef RBS_NO_MAIN
 int main() {
     RideBookingSystem rbs;
     while (true) {
@@ -738,4 +4603,5 @@ int main() {
             default: cout << "Invalid choice.\n";
         }
     }
-}
\ No newline at end of file
+}
+#endif